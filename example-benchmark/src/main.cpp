@@ -0,0 +1,8 @@
+#include "testApp.h"
+
+//--------------------------------------------------------------
+int main()
+{
+    ofSetupOpenGL(1024, 768, OF_WINDOW);            // <-------- setup the GL context
+	ofRunApp(new testApp()); // start the app
+}
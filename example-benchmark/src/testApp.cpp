@@ -0,0 +1,761 @@
+#include "testApp.h"
+
+#include "ofxAlembic.h"
+
+#include <fstream>
+
+stringstream report;
+
+template <typename F>
+static double measure(int iterations, F f)
+{
+	uint64_t t = ofGetElapsedTimeMicros();
+	for (int i = 0; i < iterations; i++)
+		f();
+	return (ofGetElapsedTimeMicros() - t) / (double)iterations;
+}
+
+static void benchmarkGather()
+{
+	const size_t num_src = 1000000;
+	const size_t num = 6000000; // ~2M triangles worth of corners
+	const int iterations = 20;
+
+	vector<float> src3(num_src * 3), src2(num_src * 2);
+	for (size_t i = 0; i < src3.size(); i++) src3[i] = ofRandomf();
+	for (size_t i = 0; i < src2.size(); i++) src2[i] = ofRandomf();
+
+	vector<uint32_t> idx(num);
+	for (size_t i = 0; i < num; i++) idx[i] = ofRandom(num_src);
+
+	vector<uint32_t> idx2(num_src);
+	for (size_t i = 0; i < num_src; i++) idx2[i] = ofRandom(num_src);
+
+	vector<float> dst3(num * 3), dst2(num * 2);
+
+	report << "gather kernels, " << num << " elements from " << num_src << endl;
+
+	for (int l = ofxAlembic::SIMD_SCALAR; l <= ofxAlembic::getSupportedSimdLevel(); l++)
+	{
+		ofxAlembic::setSimdLevel((ofxAlembic::SimdLevel)l);
+
+		double v3 = measure(iterations, [&]() { ofxAlembic::gatherV3f(dst3.data(), src3.data(), num_src, idx.data(), num); });
+		double v2 = measure(iterations, [&]() { ofxAlembic::gatherV2f(dst2.data(), src2.data(), num_src, idx.data(), num); });
+		double v2i = measure(iterations, [&]() { ofxAlembic::gatherV2f(dst2.data(), src2.data(), num_src, idx.data(), num, idx2.data()); });
+
+		// output bytes per microsecond == MB/s
+		report << "  " << ofxAlembic::getSimdLevelName((ofxAlembic::SimdLevel)l)
+			<< "  V3f " << (int)(num * 12 / v3) << " MB/s"
+			<< "  V2f " << (int)(num * 8 / v2) << " MB/s"
+			<< "  V2f indexed " << (int)(num * 8 / v2i) << " MB/s" << endl;
+	}
+
+	ofxAlembic::setSimdLevel(ofxAlembic::getSupportedSimdLevel());
+	report << endl;
+}
+
+static void writeSceneGraph(const string& path, int depth, int fanout, int num_frames)
+{
+	ofxAlembic::Writer writer;
+	if (!writer.open(path, 30)) return;
+
+	// parents have to exist before their children, write level by level
+	vector<string> level(1, "");
+	size_t node = 0;
+
+	for (int d = 0; d < depth; d++)
+	{
+		vector<string> next;
+		for (int i = 0; i < level.size(); i++)
+		{
+			for (int c = 0; c < fanout; c++)
+			{
+				string p = level[i] + "/n" + ofToString(c);
+				glm::mat4 m = glm::translate(glm::mat4(1.0), glm::vec3(1, 0, 0));
+				writer.addXform(p, m);
+				next.push_back(p);
+
+				node++;
+			}
+		}
+		level.swap(next);
+	}
+
+	// every 10th node of the last level is animated
+	for (int f = 1; f < num_frames; f++)
+	{
+		writer.setTime(f / 30.f);
+
+		for (int i = 0; i < level.size(); i += 10)
+			writer.addXform(level[i], glm::rotate(glm::mat4(1.0), f * 0.1f, glm::vec3(0, 1, 0)));
+	}
+
+	report << "scene graph, wrote " << node << " xforms to " << path << endl;
+}
+
+static void benchmarkSceneGraph()
+{
+	const string path = "scene_graph.abc";
+	const int num_frames = 30;
+
+	if (!ofFile::doesFileExist(path))
+		writeSceneGraph(path, 5, 10, num_frames);
+
+	ofxAlembic::Reader abc;
+
+	uint64_t t = ofGetElapsedTimeMicros();
+	if (!abc.open(path))
+	{
+		report << "scene graph, can't open " << path << endl << endl;
+		return;
+	}
+	double open = (ofGetElapsedTimeMicros() - t) / 1000.;
+
+	const ofxAlembic::Scene &scene = abc.getScene();
+
+	int frame = 0;
+	size_t recomputed = 0;
+	double animated = measure(num_frames * 4, [&]()
+	{
+		abc.setTime((frame++ % num_frames) / 30.);
+		recomputed += abc.getNumRecomputedTransforms();
+	});
+
+	// nothing decodes, so no chain is touched either
+	double sweep = measure(100, [&]() { abc.setTime(0.5); });
+
+	report << "scene graph, " << scene.size() << " nodes, " << scene.getNumAnimatedXforms() << " animated, "
+		<< scene.getNumDynamicNodes() << " below an animated xform" << endl
+		<< "  open " << open << " ms" << endl
+		<< "  setTime while playing " << animated / 1000. << " ms, "
+		<< recomputed / (num_frames * 4) << " matrices recomputed per frame" << endl
+		<< "  setTime, nothing changed " << sweep / 1000. << " ms" << endl;
+
+	// same playback with every xform sample read into a table up front
+	t = ofGetElapsedTimeMicros();
+	abc.setBakedXforms(true);
+	double bake = (ofGetElapsedTimeMicros() - t) / 1000.;
+
+	double baked = measure(num_frames * 4, [&]()
+	{
+		abc.setTime((frame++ % num_frames) / 30.);
+	});
+
+	report << "  baked xforms, " << abc.getBakedXformMemoryUsage() / 1024 << " KB, baked in " << bake << " ms" << endl
+		<< "  setTime while playing " << baked / 1000. << " ms, " << animated / baked << "x" << endl;
+
+	// one branch out of ten is read, the other animated xforms are skipped
+	abc.setBakedXforms(false);
+	size_t subscribed = abc.subscribe("/n0/*");
+
+	double selective = measure(num_frames * 4, [&]()
+	{
+		abc.setTime((frame++ % num_frames) / 30.);
+	});
+
+	report << "  subscribed to /n0/*, " << subscribed << " objects, " << abc.getNumSkippedObjects() << " animated objects skipped" << endl
+		<< "  setTime while playing " << selective / 1000. << " ms, " << animated / selective << "x" << endl << endl;
+}
+
+static void writeSetDressing(const string& path, int num_groups, int num_per_group)
+{
+	ofxAlembic::Writer writer;
+	if (!writer.open(path, 30)) return;
+
+	ofMesh box = ofMesh::box(1, 1, 1, 1, 1, 1);
+
+	for (int g = 0; g < num_groups; g++)
+	{
+		string group = "/group" + ofToString(g);
+		writer.addXform(group, glm::translate(glm::mat4(1.0), glm::vec3(g, 0, 0)));
+
+		for (int i = 0; i < num_per_group; i++)
+		{
+			string p = group + "/prop" + ofToString(i);
+			writer.addXform(p, glm::translate(glm::mat4(1.0), glm::vec3(0, i, 0)));
+			writer.addPolyMesh(p + "/propShape", box);
+		}
+	}
+
+	report << "set dressing, wrote " << num_groups * num_per_group << " props to " << path << endl;
+}
+
+static void benchmarkSidecarIndex()
+{
+	const string path = "set_dressing.abc";
+
+	if (!ofFile::doesFileExist(path))
+		writeSetDressing(path, 200, 100);
+
+	// the index is rebuilt from scratch for the cold run
+	ofFile::removeFile(ofxAlembic::ArchiveIndex::getIndexPath(ofToDataPath(path)), false);
+
+	auto open = [&](bool index, bool& hit)
+	{
+		ofxAlembic::Reader abc;
+		abc.setLazy(true);
+		abc.setSidecarIndex(index);
+
+		uint64_t t = ofGetElapsedTimeMicros();
+		abc.open(path);
+		double ms = (ofGetElapsedTimeMicros() - t) / 1000.;
+
+		hit = abc.isArchiveIndexHit();
+		return ms;
+	};
+
+	bool hit;
+	double plain = open(false, hit);
+	double cold = open(true, hit);
+	double warm = open(true, hit);
+
+	ofFile index(ofxAlembic::ArchiveIndex::getIndexPath(ofToDataPath(path)), ofFile::Reference, false);
+
+	report << "sidecar index, lazy open of " << path << endl
+		<< "  no index " << plain << " ms" << endl
+		<< "  cold, writes the index " << cold << " ms" << endl
+		<< "  warm " << warm << " ms" << (hit ? "" : " (index was not used)") << ", " << index.getSize() / 1024 << " KB index" << endl << endl;
+}
+
+static void writeDeformingMesh(const string& path, int res, int num_frames)
+{
+	ofxAlembic::Writer writer;
+	if (!writer.open(path, 30)) return;
+
+	ofMesh mesh;
+	for (int y = 0; y < res; y++)
+		for (int x = 0; x < res; x++)
+			mesh.addVertex(glm::vec3(x, y, 0));
+
+	for (int y = 0; y < res - 1; y++)
+	{
+		for (int x = 0; x < res - 1; x++)
+		{
+			int i = y * res + x;
+			mesh.addIndex(i); mesh.addIndex(i + 1); mesh.addIndex(i + res);
+			mesh.addIndex(i + 1); mesh.addIndex(i + res + 1); mesh.addIndex(i + res);
+		}
+	}
+
+	for (int f = 0; f < num_frames; f++)
+	{
+		writer.setTime(f / 30.f);
+
+		vector<glm::vec3> &v = mesh.getVertices();
+		for (int i = 0; i < v.size(); i++)
+			v[i].z = sin(v[i].x * 0.1f + f * 0.2f);
+
+		writer.addPolyMesh("/wave", mesh);
+	}
+
+	report << "deforming mesh, wrote " << mesh.getNumVertices() << " vertices x " << num_frames << " frames to " << path << endl;
+}
+
+static void benchmarkSnapshots()
+{
+	const string path = "deforming.abc";
+	const int num_frames = 60;
+
+	if (!ofFile::doesFileExist(path))
+		writeDeformingMesh(path, 512, num_frames);
+
+	ofxAlembic::Reader abc;
+	abc.setSnapshots(true);
+	if (!abc.open(path))
+	{
+		report << "snapshots, can't open " << path << endl << endl;
+		return;
+	}
+
+	// a worker plays the archive while this thread reads frames like a renderer would
+	std::atomic<bool> done(false);
+	double decode = 0;
+
+	std::thread worker([&]()
+	{
+		int frame = 0;
+		decode = measure(num_frames * 2, [&]() { abc.setTime((frame++ % num_frames) / 30.); });
+		done = true;
+	});
+
+	size_t num_reads = 0, num_frames_seen = 0;
+	uint64_t last_frame = 0, worst = 0;
+
+	while (!done)
+	{
+		uint64_t t = ofGetElapsedTimeMicros();
+
+		ofPtr<const ofxAlembic::Snapshot> snapshot = abc.getSnapshot();
+		const ofxAlembic::PolyMesh *mesh = snapshot->getPolyMesh(abc.get("/wave"));
+		volatile size_t num = mesh ? mesh->mesh.getNumVertices() : 0;
+		(void)num;
+
+		worst = std::max<uint64_t>(worst, ofGetElapsedTimeMicros() - t);
+		num_reads++;
+
+		if (snapshot->getFrame() != last_frame)
+		{
+			last_frame = snapshot->getFrame();
+			num_frames_seen++;
+		}
+	}
+
+	worker.join();
+
+	report << "snapshots, setTime on a worker, reads on the main thread" << endl
+		<< "  setTime " << decode / 1000. << " ms per frame" << endl
+		<< "  " << num_reads << " reads saw " << num_frames_seen << " frames, slowest read " << worst << " us" << endl << endl;
+}
+
+static void benchmarkScrubbing()
+{
+	const string path = "deforming.abc";
+	const int num_frames = 60;
+	const int num_events = 40;
+
+	if (!ofFile::doesFileExist(path))
+		writeDeformingMesh(path, 512, num_frames);
+
+	// a drag sends a new time every 4ms, only the last one has to end up on screen
+	auto scrub = [&](ofxAlembic::Reader& abc, bool async, double& stall, double& latency)
+	{
+		std::future<double> last;
+		double call = 0;
+		stall = 0;
+
+		for (int i = 0; i < num_events; i++)
+		{
+			double time = ((i * 7) % num_frames) / 30.;
+
+			uint64_t t = ofGetElapsedTimeMicros();
+			if (async)
+				last = abc.setTimeAsync(time);
+			else
+				abc.setTime(time);
+			call = ofGetElapsedTimeMicros() - t;
+			stall = std::max(stall, call);
+
+			if (i + 1 < num_events)
+				std::this_thread::sleep_for(std::chrono::milliseconds(4));
+		}
+
+		uint64_t t = ofGetElapsedTimeMicros();
+		if (async) last.wait();
+		latency = call + (ofGetElapsedTimeMicros() - t);
+	};
+
+	ofxAlembic::Reader abc;
+	if (!abc.open(path))
+	{
+		report << "scrubbing, can't open " << path << endl << endl;
+		return;
+	}
+
+	double sync_stall, sync_latency;
+	scrub(abc, false, sync_stall, sync_latency);
+
+	// publishes the first frame, outside the measured calls
+	abc.setSnapshots(true);
+
+	double async_stall, async_latency;
+	scrub(abc, true, async_stall, async_latency);
+
+	report << "scrubbing, " << num_events << " time changes 4ms apart" << endl
+		<< "  setTime, longest ui stall " << sync_stall / 1000. << " ms, last event to ready frame "
+		<< sync_latency / 1000. << " ms" << endl
+		<< "  setTimeAsync, longest ui stall " << async_stall / 1000. << " ms, last event to ready frame "
+		<< async_latency / 1000. << " ms" << endl
+		<< "  " << abc.getNumCoalescedRequests() << " requests coalesced, " << abc.getNumCancelledRequests() << " cancelled" << endl << endl;
+}
+
+static void benchmarkEvaluate()
+{
+	const string path = "deforming.abc";
+	const int num_frames = 60;
+
+	if (!ofFile::doesFileExist(path))
+		writeDeformingMesh(path, 512, num_frames);
+
+	ofxAlembic::Reader abc;
+	if (!abc.open(path))
+	{
+		report << "evaluate, can't open " << path << endl << endl;
+		return;
+	}
+
+	ofxAlembic::Handle wave = abc.resolve("/wave");
+	const size_t n = abc.getEvaluateSize(wave);
+
+	// bake the whole range, then a shutter with 8 subframes that all land on 2 samples
+	vector<double> range(num_frames);
+	for (int i = 0; i < num_frames; i++)
+		range[i] = i / 30.;
+
+	vector<double> shutter(8);
+	for (int i = 0; i < shutter.size(); i++)
+		shutter[i] = (10 + i / 8.) / 30.;
+
+	vector<glm::vec3> out(n * num_frames);
+
+	double per_frame = measure(1, [&]()
+	{
+		ofMesh mesh;
+		for (int i = 0; i < range.size(); i++)
+		{
+			abc.setTime(range[i]);
+			abc.get(wave, mesh);
+			std::copy(mesh.getVertices().begin(), mesh.getVertices().end(), out.begin() + i * n);
+		}
+	});
+
+	double batch = measure(1, [&]() { abc.evaluate(wave, range, out.data()); });
+	double blur = measure(10, [&]() { abc.evaluate(wave, shutter, out.data()); });
+
+	report << "evaluate, " << n << " vertices" << endl
+		<< "  " << num_frames << " frames with setTime + get " << per_frame / 1000. << " ms" << endl
+		<< "  " << num_frames << " frames with evaluate " << batch / 1000. << " ms, " << per_frame / batch << "x" << endl
+		<< "  " << shutter.size() << " shutter subframes " << blur / 1000. << " ms" << endl << endl;
+}
+
+static void benchmarkCapture()
+{
+	const int res = 256;
+	const int num_frames = 120;
+
+	ofMesh mesh;
+	for (int y = 0; y < res; y++)
+		for (int x = 0; x < res; x++)
+			mesh.addVertex(glm::vec3(x, y, 0));
+
+	for (int i = 0; i < (res - 1) * (res - 1); i++)
+	{
+		int k = (i / (res - 1)) * res + i % (res - 1);
+		mesh.addIndex(k); mesh.addIndex(k + 1); mesh.addIndex(k + res);
+		mesh.addIndex(k + 1); mesh.addIndex(k + res + 1); mesh.addIndex(k + res);
+	}
+
+	report << "capture, " << mesh.getNumVertices() << " vertices x " << num_frames << " frames" << endl;
+
+	// the longest add call is the frame the render loop would drop
+	auto capture = [&](const string& name, bool async, ofxAlembic::Writer::QueuePolicy policy)
+	{
+		ofxAlembic::Writer writer;
+		if (!writer.open("capture.abc", 60)) return;
+		writer.setAsync(async, 8, policy);
+
+		uint64_t longest = 0;
+		uint64_t start = ofGetElapsedTimeMicros();
+
+		for (int f = 0; f < num_frames; f++)
+		{
+			vector<glm::vec3> &v = mesh.getVertices();
+			for (int i = 0; i < v.size(); i++)
+				v[i].z = sin(v[i].x * 0.1f + f * 0.2f);
+
+			uint64_t t = ofGetElapsedTimeMicros();
+			writer.addPolyMesh("/wave", mesh);
+			longest = std::max(longest, ofGetElapsedTimeMicros() - t);
+
+			writer.flashFrame();
+		}
+
+		writer.flush();
+		uint64_t total = ofGetElapsedTimeMicros() - start;
+
+		report << "  " << name << ", longest add " << longest / 1000. << " ms, total " << total / 1000. << " ms";
+		if (async)
+			report << ", max depth " << writer.getMaxQueueDepth() << ", " << writer.getNumStalls() << " stalls, "
+				<< writer.getNumDropped() << " dropped";
+		report << endl;
+	};
+
+	capture("sync", false, ofxAlembic::Writer::QUEUE_BLOCK);
+	capture("async block", true, ofxAlembic::Writer::QUEUE_BLOCK);
+	capture("async drop", true, ofxAlembic::Writer::QUEUE_DROP);
+	capture("async grow", true, ofxAlembic::Writer::QUEUE_GROW);
+
+	report << endl;
+}
+
+static void benchmarkTopologyMode()
+{
+	const int res = 317; // ~100k vertices
+	const int num_frames = 1000;
+
+	ofMesh mesh;
+	for (int y = 0; y < res; y++)
+	{
+		for (int x = 0; x < res; x++)
+		{
+			mesh.addVertex(glm::vec3(x, y, 0));
+			mesh.addTexCoord(glm::vec2(x / (res - 1.f), y / (res - 1.f)));
+		}
+	}
+
+	for (int i = 0; i < (res - 1) * (res - 1); i++)
+	{
+		int k = (i / (res - 1)) * res + i % (res - 1);
+		mesh.addIndex(k); mesh.addIndex(k + 1); mesh.addIndex(k + res);
+		mesh.addIndex(k + 1); mesh.addIndex(k + res + 1); mesh.addIndex(k + res);
+	}
+
+	report << "topology mode, " << mesh.getNumVertices() << " vertices x " << num_frames << " frames" << endl;
+
+	auto record = [&](const string& name, ofxAlembic::Writer::TopologyMode mode)
+	{
+		const string path = "topology.abc";
+		uint64_t elapsed = 0;
+		size_t skipped = 0;
+
+		{
+			ofxAlembic::Writer writer;
+			if (!writer.open(path, 30)) return;
+			writer.setTopologyMode("/wave", mode);
+
+			for (int f = 0; f < num_frames; f++)
+			{
+				vector<glm::vec3> &v = mesh.getVertices();
+				for (int i = 0; i < v.size(); i++)
+					v[i].z = sin(v[i].x * 0.1f + f * 0.2f);
+
+				uint64_t t = ofGetElapsedTimeMicros();
+				writer.addPolyMesh("/wave", mesh);
+				elapsed += ofGetElapsedTimeMicros() - t;
+
+				writer.flashFrame();
+			}
+
+			skipped = writer.getNumTopologySkipped();
+		}
+
+		report << "  " << name << ", " << elapsed / 1000. << " ms, " << ofFile(path, ofFile::Reference).getSize() / 1024 << " KB, "
+			<< skipped << " samples with positions only" << endl;
+
+		ofFile::removeFile(path);
+	};
+
+	record("varying", ofxAlembic::Writer::TOPOLOGY_VARYING);
+	record("detect", ofxAlembic::Writer::TOPOLOGY_DETECT);
+	record("homogeneous", ofxAlembic::Writer::TOPOLOGY_HOMOGENEOUS);
+
+	report << endl;
+}
+
+static void benchmarkHandles()
+{
+	const int num_objects = 2000;
+	const int num_frames = 30;
+
+	vector<string> paths(num_objects);
+	for (int i = 0; i < num_objects; i++)
+		paths[i] = "/crowd/group" + ofToString(i / 100) + "/agent" + ofToString(i);
+
+	ofxAlembic::XForm xform;
+	report << "handles, " << num_objects << " xforms x " << num_frames << " frames" << endl;
+
+	auto record = [&](const string& name, bool handles)
+	{
+		ofxAlembic::Writer writer;
+		if (!writer.open("handles.abc", 30)) return;
+
+		uint64_t t = ofGetElapsedTimeMicros();
+
+		// parents are created as xforms on the way
+		vector<ofxAlembic::Writer::Handle<ofxAlembic::XForm> > agents;
+		if (handles)
+		{
+			for (int i = 0; i < num_objects; i++)
+				agents.push_back(writer.create<ofxAlembic::XForm>(paths[i]));
+		}
+
+		for (int f = 0; f < num_frames; f++)
+		{
+			for (int i = 0; i < num_objects; i++)
+			{
+				if (handles) writer.add(agents[i], xform);
+				else writer.addXform(paths[i], xform);
+			}
+
+			writer.flashFrame();
+		}
+
+		writer.close();
+		report << "  " << name << " " << (ofGetElapsedTimeMicros() - t) / 1000. << " ms" << endl;
+	};
+
+	record("paths", false);
+	record("handles", true);
+
+	ofFile::removeFile("handles.abc");
+	report << endl;
+}
+
+static bool sameFile(const string& a, const string& b)
+{
+	std::ifstream fa(ofToDataPath(a).c_str(), std::ios::binary);
+	std::ifstream fb(ofToDataPath(b).c_str(), std::ios::binary);
+
+	std::istreambuf_iterator<char> end;
+	return fa && fb && std::equal(std::istreambuf_iterator<char>(fa), end, std::istreambuf_iterator<char>(fb));
+}
+
+static void benchmarkFrameBatch()
+{
+	const int num_objects = 200;
+	const int res = 64;
+	const int num_frames = 30;
+
+	ofMesh mesh;
+	for (int y = 0; y < res; y++)
+		for (int x = 0; x < res; x++)
+			mesh.addVertex(glm::vec3(x, y, 0));
+
+	for (int i = 0; i < (res - 1) * (res - 1); i++)
+	{
+		int k = (i / (res - 1)) * res + i % (res - 1);
+		mesh.addIndex(k); mesh.addIndex(k + 1); mesh.addIndex(k + res);
+		mesh.addIndex(k + 1); mesh.addIndex(k + res + 1); mesh.addIndex(k + res);
+	}
+
+	report << "frame batch, " << num_objects << " meshes of " << mesh.getNumVertices() << " vertices x " << num_frames << " frames" << endl;
+
+	auto record = [&](const string& path, bool batch) -> double
+	{
+		ofxAlembic::Writer writer;
+		if (!writer.open(path, 30)) return 0;
+		writer.setParallel(batch);
+
+		vector<ofxAlembic::Writer::Handle<ofxAlembic::PolyMesh> > agents;
+		for (int i = 0; i < num_objects; i++)
+			agents.push_back(writer.create<ofxAlembic::PolyMesh>("/crowd/agent" + ofToString(i)));
+
+		vector<ofxAlembic::PolyMesh> meshes(num_objects, ofxAlembic::PolyMesh(mesh));
+
+		uint64_t elapsed = 0;
+		for (int f = 0; f < num_frames; f++)
+		{
+			for (int i = 0; i < num_objects; i++)
+			{
+				vector<glm::vec3> &v = meshes[i].mesh.getVertices();
+				for (int k = 0; k < v.size(); k++)
+					v[k].z = sin(v[k].x * 0.1f + f * 0.2f + i);
+			}
+
+			uint64_t t = ofGetElapsedTimeMicros();
+
+			if (batch) writer.beginFrame();
+			for (int i = 0; i < num_objects; i++)
+				writer.add(agents[i], meshes[i]);
+			if (batch) writer.endFrame();
+
+			elapsed += ofGetElapsedTimeMicros() - t;
+			writer.flashFrame();
+		}
+
+		return elapsed;
+	};
+
+	double serial = record("serial.abc", false);
+	double batch = record("batch.abc", true);
+
+	report << "  serial " << serial / 1000. << " ms" << endl
+		<< "  beginFrame/endFrame " << batch / 1000. << " ms, " << serial / batch << "x, "
+		<< (sameFile("serial.abc", "batch.abc") ? "identical" : "different") << " output" << endl << endl;
+
+	ofFile::removeFile("serial.abc");
+	ofFile::removeFile("batch.abc");
+}
+
+//--------------------------------------------------------------
+void testApp::setup()
+{
+	ofSetVerticalSync(true);
+	ofSetFrameRate(60);
+	ofBackground(0);
+
+	benchmarkGather();
+	benchmarkSceneGraph();
+	benchmarkSidecarIndex();
+	benchmarkSnapshots();
+	benchmarkScrubbing();
+	benchmarkEvaluate();
+	benchmarkCapture();
+	benchmarkTopologyMode();
+	benchmarkHandles();
+	benchmarkFrameBatch();
+
+	cout << report.str();
+}
+
+//--------------------------------------------------------------
+void testApp::update()
+{
+	
+}
+
+//--------------------------------------------------------------
+void testApp::draw()
+{
+	ofSetColor(255);
+	ofDrawBitmapString(report.str(), 10, 20);
+}
+
+//--------------------------------------------------------------
+void testApp::exit()
+{
+
+}
+
+//--------------------------------------------------------------
+void testApp::keyPressed(int key)
+{
+	
+}
+
+//--------------------------------------------------------------
+void testApp::keyReleased(int key)
+{
+
+}
+
+//--------------------------------------------------------------
+void testApp::mouseMoved(int x, int y)
+{
+
+}
+
+//--------------------------------------------------------------
+void testApp::mouseDragged(int x, int y, int button)
+{
+
+}
+
+//--------------------------------------------------------------
+void testApp::mousePressed(int x, int y, int button)
+{
+
+}
+
+//--------------------------------------------------------------
+void testApp::mouseReleased(int x, int y, int button)
+{
+
+}
+
+//--------------------------------------------------------------
+void testApp::windowResized(int w, int h)
+{
+
+}
+
+//--------------------------------------------------------------
+void testApp::gotMessage(ofMessage msg)
+{
+
+}
+
+//--------------------------------------------------------------
+void testApp::dragEvent(ofDragInfo dragInfo)
+{
+
+}
@@ -15,6 +15,9 @@ void testApp::setup()
 	
 	string path = "sample.abc";
 	
+	// only evaluate what draw() reads, without this every object is updated
+	abc.subscribe({ "/Cloner/ClonerShape", "/Emitter/EmitterCloud", "/Tracer/TracerSpline" });
+	
 	// load allembic file
 	abc.open(path);
 	
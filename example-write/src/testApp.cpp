@@ -96,6 +96,32 @@ void testApp::setup()
 					}
 				}
 				
+				// quads, the indices are grouped by face_counts
+				if (f == 0)
+				{
+					ofMesh grid;
+					vector<int32_t> face_counts;
+					
+					for (int y = 0; y <= 10; y++)
+						for (int x = 0; x <= 10; x++)
+							grid.addVertex(glm::vec3(x * 20 - 100, y * 20 - 100, -200));
+					
+					for (int y = 0; y < 10; y++)
+					{
+						for (int x = 0; x < 10; x++)
+						{
+							int i = y * 11 + x;
+							grid.addIndex(i);
+							grid.addIndex(i + 11);
+							grid.addIndex(i + 12);
+							grid.addIndex(i + 1);
+							face_counts.push_back(4);
+						}
+					}
+					
+					writer.addPolyMesh("/quads", ofxAlembic::PolyMesh(grid, face_counts));
+				}
+				
 				// camera
 				{
 					outcam.setFov(20 + f * 0.5);
@@ -2,5 +2,13 @@
 
 #include "ofxAlembicType.h"
 #include "ofxAlembicUtil.h"
+#include "ofxAlembicThreadPool.h"
+#include "ofxAlembicGather.h"
+#include "ofxAlembicScene.h"
+#include "ofxAlembicIndex.h"
 #include "ofxAlembicReader.h"
+#include "ofxAlembicPrefetcher.h"
+#include "ofxAlembicFrameCache.h"
+#include "ofxAlembicSnapshot.h"
+#include "ofxAlembicAsync.h"
 #include "ofxAlembicWriter.h"
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "ofxAlembicAsync.h"
+
+using namespace ofxAlembic;
+
+AsyncUpdater::AsyncUpdater(Reader* reader)
+	: reader(reader)
+	, running(true)
+	, pending(false)
+	, pending_time(0)
+	, last_time(reader->getTime())
+	, latest(0)
+	, num_coalesced(0)
+	, num_cancelled(0)
+{
+	thread = std::thread(&AsyncUpdater::threadLoop, this);
+}
+
+AsyncUpdater::~AsyncUpdater()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+		latest++; // abandons the frame in flight
+	}
+	cond.notify_all();
+
+	thread.join();
+
+	// nothing newer is coming, answer with what readers see
+	for (int i = 0; i < waiters.size(); i++)
+		waiters[i].set_value(last_time);
+}
+
+std::future<double> AsyncUpdater::request(double time)
+{
+	std::promise<double> promise;
+	std::future<double> future = promise.get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (pending)
+			num_coalesced++;
+
+		pending = true;
+		pending_time = time;
+		latest++;
+
+		waiters.push_back(std::move(promise));
+	}
+
+	cond.notify_one();
+	return future;
+}
+
+size_t AsyncUpdater::getNumCoalesced() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return num_coalesced;
+}
+
+size_t AsyncUpdater::getNumCancelled() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return num_cancelled;
+}
+
+void AsyncUpdater::threadLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		cond.wait(lock, [&]() { return !running || pending; });
+		if (!running) break;
+
+		const double time = pending_time;
+		const uint64_t request = latest;
+		pending = false;
+
+		vector<std::promise<double> > batch;
+		batch.swap(waiters);
+
+		lock.unlock();
+
+		bool published = false;
+		std::exception_ptr error;
+
+		try
+		{
+			published = reader->updateTime(time, this, request);
+		}
+		catch (std::exception &e)
+		{
+			ofLogError("ofxAlembic::AsyncUpdater") << e.what();
+			error = std::current_exception();
+		}
+
+		lock.lock();
+
+		if (error)
+		{
+			// the callers see the read error through their futures
+			for (int i = 0; i < batch.size(); i++)
+				batch[i].set_exception(error);
+		}
+		else if (published)
+		{
+			last_time = time;
+			for (int i = 0; i < batch.size(); i++)
+				batch[i].set_value(time);
+		}
+		else
+		{
+			// the newer request answers them
+			num_cancelled++;
+			for (int i = 0; i < batch.size(); i++)
+				waiters.push_back(std::move(batch[i]));
+		}
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+
+#include "ofxAlembicReader.h"
+
+namespace ofxAlembic
+{
+class AsyncUpdater;
+}
+
+// runs Reader::setTime on its own thread for scrubbing. only the newest request
+// matters, one still waiting is replaced and one being decoded is abandoned.
+// every future becomes ready with the time of the first frame published after its request,
+// or with the exception of a frame that failed to decode
+
+class ofxAlembic::AsyncUpdater
+{
+public:
+
+	AsyncUpdater(Reader* reader);
+	~AsyncUpdater();
+
+	std::future<double> request(double time);
+
+	// requests replaced before they started, and abandoned while decoding
+	size_t getNumCoalesced() const;
+	size_t getNumCancelled() const;
+
+	// read by the reader between leaves, a newer request makes the running one stale
+	inline bool isStale(uint64_t request) const { return latest != request; }
+
+protected:
+
+	Reader *reader;
+
+	mutable std::mutex mutex;
+	std::condition_variable cond;
+	std::thread thread;
+
+	bool running;
+	bool pending;
+	double pending_time;
+	double last_time;
+	std::atomic<uint64_t> latest;
+
+	// answered together by the next frame that gets published
+	vector<std::promise<double> > waiters;
+
+	size_t num_coalesced;
+	size_t num_cancelled;
+
+	void threadLoop();
+};
@@ -0,0 +1,113 @@
+#include "ofxAlembicFrameCache.h"
+
+using namespace ofxAlembic;
+using namespace Alembic::AbcGeom;
+
+FrameCache::FrameCache(size_t max_bytes) : max_bytes(max_bytes), bytes(0), hits(0), misses(0) {}
+
+ofPtr<SampleData> FrameCache::take(size_t leaf, index_t index)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	map<Key, Entry>::iterator it = entries.find(Key(leaf, index));
+	if (it == entries.end())
+	{
+		misses++;
+		return ofPtr<SampleData>();
+	}
+
+	ofPtr<SampleData> data = it->second.data;
+	bytes -= it->second.bytes;
+	lru.erase(it->second.lru);
+	entries.erase(it);
+	hits++;
+
+	return data;
+}
+
+void FrameCache::put(size_t leaf, const ofPtr<SampleData>& data)
+{
+	if (!data || data->index < 0) return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Key key(leaf, data->index);
+
+	map<Key, Entry>::iterator it = entries.find(key);
+	if (it != entries.end())
+	{
+		bytes -= it->second.bytes;
+		lru.erase(it->second.lru);
+		entries.erase(it);
+	}
+
+	Entry &e = entries[key];
+	e.data = data;
+	e.bytes = data->getMemoryUsage();
+	lru.push_front(key);
+	e.lru = lru.begin();
+
+	bytes += e.bytes;
+
+	evict();
+}
+
+void FrameCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	entries.clear();
+	lru.clear();
+	bytes = 0;
+}
+
+void FrameCache::setMaxBytes(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	max_bytes = bytes;
+	evict();
+}
+
+size_t FrameCache::getMaxBytes() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return max_bytes;
+}
+
+size_t FrameCache::getMemoryUsage() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return bytes;
+}
+
+size_t FrameCache::getHits() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return hits;
+}
+
+size_t FrameCache::getMisses() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return misses;
+}
+
+float FrameCache::getHitRatio() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	size_t total = hits + misses;
+	return total ? (float)hits / total : 0;
+}
+
+void FrameCache::evict()
+{
+	while (bytes > max_bytes && !lru.empty())
+	{
+		map<Key, Entry>::iterator it = entries.find(lru.back());
+		bytes -= it->second.bytes;
+		entries.erase(it);
+		lru.pop_back();
+	}
+}
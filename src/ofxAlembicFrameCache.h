@@ -0,0 +1,59 @@
+#pragma once
+
+#include <mutex>
+#include <list>
+
+#include "ofxAlembicReader.h"
+
+namespace ofxAlembic
+{
+class FrameCache;
+}
+
+// decoded samples keyed by (leaf, sample index), least recently used ones are
+// evicted once the resident size exceeds max_bytes
+
+class ofxAlembic::FrameCache
+{
+public:
+
+	FrameCache(size_t max_bytes);
+
+	// removes and returns the cached sample, counts a hit or a miss
+	ofPtr<SampleData> take(size_t leaf, Alembic::AbcGeom::index_t index);
+
+	// stores data under data->index
+	void put(size_t leaf, const ofPtr<SampleData>& data);
+
+	void clear();
+
+	void setMaxBytes(size_t bytes);
+	size_t getMaxBytes() const;
+
+	size_t getMemoryUsage() const;
+	size_t getHits() const;
+	size_t getMisses() const;
+	float getHitRatio() const;
+
+protected:
+
+	typedef std::pair<size_t, Alembic::AbcGeom::index_t> Key;
+
+	struct Entry
+	{
+		ofPtr<SampleData> data;
+		size_t bytes;
+		std::list<Key>::iterator lru;
+	};
+
+	map<Key, Entry> entries;
+	std::list<Key> lru; // front is the most recently used
+
+	size_t max_bytes;
+	size_t bytes;
+	size_t hits, misses;
+
+	mutable std::mutex mutex;
+
+	void evict();
+};
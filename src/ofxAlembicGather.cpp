@@ -0,0 +1,289 @@
+#include "ofxAlembicGather.h"
+
+#include <cstring>
+#include <cassert>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define OFXALEMBIC_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define OFXALEMBIC_TARGET_SSE
+#define OFXALEMBIC_TARGET_AVX2
+#else
+#define OFXALEMBIC_TARGET_SSE __attribute__((target("sse4.1")))
+#define OFXALEMBIC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+using namespace ofxAlembic;
+
+#pragma mark - cpu detection
+
+static SimdLevel detectSimdLevel()
+{
+#if defined(OFXALEMBIC_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+
+	bool sse41 = (info[2] & (1 << 19)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	bool avx2 = false;
+	if (osxsave && avx && (_xgetbv(0) & 6) == 6)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+
+	if (avx2) return SIMD_AVX2;
+	if (sse41) return SIMD_SSE;
+#elif defined(OFXALEMBIC_X86)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+	if (__builtin_cpu_supports("sse4.1")) return SIMD_SSE;
+#endif
+
+	return SIMD_SCALAR;
+}
+
+static std::atomic<int> simd_level(-1);
+
+SimdLevel ofxAlembic::getSupportedSimdLevel()
+{
+	static SimdLevel level = detectSimdLevel();
+	return level;
+}
+
+SimdLevel ofxAlembic::getSimdLevel()
+{
+	int level = simd_level;
+	if (level < 0)
+	{
+		level = getSupportedSimdLevel();
+		simd_level = level;
+	}
+	return (SimdLevel)level;
+}
+
+void ofxAlembic::setSimdLevel(SimdLevel level)
+{
+	if (level > getSupportedSimdLevel())
+		level = getSupportedSimdLevel();
+
+	simd_level = level;
+}
+
+const char* ofxAlembic::getSimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+		case SIMD_AVX2: return "avx2";
+		case SIMD_SSE: return "sse4.1";
+		default: return "scalar";
+	}
+}
+
+#pragma mark - scalar
+
+static void gatherV3f_scalar(float* dst, const float* src, const uint32_t* idx, size_t num, const uint32_t* idx2)
+{
+	if (idx2)
+	{
+		for (size_t i = 0; i < num; i++)
+			memcpy(dst + i * 3, src + idx2[idx[i]] * 3, sizeof(float) * 3);
+	}
+	else
+	{
+		for (size_t i = 0; i < num; i++)
+			memcpy(dst + i * 3, src + idx[i] * 3, sizeof(float) * 3);
+	}
+}
+
+static void gatherV2f_scalar(float* dst, const float* src, const uint32_t* idx, size_t num, const uint32_t* idx2)
+{
+	if (idx2)
+	{
+		for (size_t i = 0; i < num; i++)
+			memcpy(dst + i * 2, src + idx2[idx[i]] * 2, sizeof(float) * 2);
+	}
+	else
+	{
+		for (size_t i = 0; i < num; i++)
+			memcpy(dst + i * 2, src + idx[i] * 2, sizeof(float) * 2);
+	}
+}
+
+#ifdef OFXALEMBIC_X86
+
+#pragma mark - sse
+
+// 16 byte load of a 12 byte element, only the last element of src can't over-read
+OFXALEMBIC_TARGET_SSE static inline __m128 load3(const float* src, size_t num_src, uint32_t j)
+{
+	const float *p = src + j * 3;
+	if (j + 1 < num_src) return _mm_loadu_ps(p);
+	return _mm_set_ps(0, p[2], p[1], p[0]);
+}
+
+OFXALEMBIC_TARGET_SSE static void gatherV3f_sse(float* dst, const float* src, size_t num_src, const uint32_t* idx, size_t num, const uint32_t* idx2)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= num; i += 4)
+	{
+		uint32_t j0 = idx[i], j1 = idx[i + 1], j2 = idx[i + 2], j3 = idx[i + 3];
+		if (idx2)
+		{
+			j0 = idx2[j0], j1 = idx2[j1], j2 = idx2[j2], j3 = idx2[j3];
+		}
+
+		__m128 a0 = load3(src, num_src, j0);
+		__m128 a1 = load3(src, num_src, j1);
+		__m128 a2 = load3(src, num_src, j2);
+		__m128 a3 = load3(src, num_src, j3);
+
+		// x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+		__m128 o0 = _mm_blend_ps(a0, _mm_shuffle_ps(a1, a1, _MM_SHUFFLE(0, 0, 0, 0)), 0x8);
+		__m128 o1 = _mm_shuffle_ps(a1, a2, _MM_SHUFFLE(1, 0, 2, 1));
+		__m128 o2 = _mm_blend_ps(_mm_shuffle_ps(a3, a3, _MM_SHUFFLE(2, 1, 0, 0)), _mm_shuffle_ps(a2, a2, _MM_SHUFFLE(2, 2, 2, 2)), 0x1);
+
+		_mm_storeu_ps(dst + i * 3 + 0, o0);
+		_mm_storeu_ps(dst + i * 3 + 4, o1);
+		_mm_storeu_ps(dst + i * 3 + 8, o2);
+	}
+
+	gatherV3f_scalar(dst + i * 3, src, idx + i, num - i, idx2);
+}
+
+OFXALEMBIC_TARGET_SSE static void gatherV2f_sse(float* dst, const float* src, const uint32_t* idx, size_t num, const uint32_t* idx2)
+{
+	size_t i = 0;
+
+	for (; i + 2 <= num; i += 2)
+	{
+		uint32_t j0 = idx[i], j1 = idx[i + 1];
+		if (idx2)
+		{
+			j0 = idx2[j0], j1 = idx2[j1];
+		}
+
+		__m128 v = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(src + j0 * 2));
+		v = _mm_loadh_pi(v, (const __m64*)(src + j1 * 2));
+		_mm_storeu_ps(dst + i * 2, v);
+	}
+
+	gatherV2f_scalar(dst + i * 2, src, idx + i, num - i, idx2);
+}
+
+#pragma mark - avx2
+
+// 4 x (x, y, z) in SoA to 12 packed floats
+OFXALEMBIC_TARGET_AVX2 static inline void store3x4(float* dst, __m128 X, __m128 Y, __m128 Z)
+{
+	__m128 xy01 = _mm_unpacklo_ps(X, Y);
+	__m128 xy23 = _mm_unpackhi_ps(X, Y);
+
+	__m128 z0x1 = _mm_shuffle_ps(Z, X, _MM_SHUFFLE(1, 1, 0, 0));
+	__m128 y1z1 = _mm_shuffle_ps(Y, Z, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 z2x3 = _mm_shuffle_ps(Z, X, _MM_SHUFFLE(3, 3, 2, 2));
+	__m128 y3z3 = _mm_shuffle_ps(Y, Z, _MM_SHUFFLE(3, 3, 3, 3));
+
+	_mm_storeu_ps(dst + 0, _mm_shuffle_ps(xy01, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+	_mm_storeu_ps(dst + 4, _mm_shuffle_ps(y1z1, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+	_mm_storeu_ps(dst + 8, _mm_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+OFXALEMBIC_TARGET_AVX2 static void gatherV3f_avx2(float* dst, const float* src, const uint32_t* idx, size_t num, const uint32_t* idx2)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= num; i += 8)
+	{
+		__m256i vi = _mm256_loadu_si256((const __m256i*)(idx + i));
+		if (idx2)
+			vi = _mm256_i32gather_epi32((const int*)idx2, vi, 4);
+
+		__m256i off = _mm256_add_epi32(vi, _mm256_add_epi32(vi, vi));
+
+		__m256 X = _mm256_i32gather_ps(src + 0, off, 4);
+		__m256 Y = _mm256_i32gather_ps(src + 1, off, 4);
+		__m256 Z = _mm256_i32gather_ps(src + 2, off, 4);
+
+		store3x4(dst + i * 3, _mm256_castps256_ps128(X), _mm256_castps256_ps128(Y), _mm256_castps256_ps128(Z));
+		store3x4(dst + i * 3 + 12, _mm256_extractf128_ps(X, 1), _mm256_extractf128_ps(Y, 1), _mm256_extractf128_ps(Z, 1));
+	}
+
+	gatherV3f_scalar(dst + i * 3, src, idx + i, num - i, idx2);
+}
+
+OFXALEMBIC_TARGET_AVX2 static void gatherV2f_avx2(float* dst, const float* src, const uint32_t* idx, size_t num, const uint32_t* idx2)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= num; i += 4)
+	{
+		__m128i vi = _mm_loadu_si128((const __m128i*)(idx + i));
+		if (idx2)
+			vi = _mm_i32gather_epi32((const int*)idx2, vi, 4);
+
+		__m256i v = _mm256_i32gather_epi64((const long long*)src, vi, 8);
+		_mm256_storeu_si256((__m256i*)(dst + i * 2), v);
+	}
+
+	gatherV2f_scalar(dst + i * 2, src, idx + i, num - i, idx2);
+}
+
+#endif
+
+#pragma mark - dispatch
+
+#ifndef NDEBUG
+// the kernels trust the indices, a bad one reads past src
+static void check_indices(size_t num_src, const uint32_t* idx, size_t num, const uint32_t* idx2)
+{
+	for (size_t i = 0; i < num; i++)
+		assert((idx2 ? idx2[idx[i]] : idx[i]) < num_src);
+}
+#endif
+
+void ofxAlembic::gatherV3f(float* dst, const float* src, size_t num_src, const uint32_t* idx, size_t num, const uint32_t* idx2)
+{
+#ifndef NDEBUG
+	check_indices(num_src, idx, num, idx2);
+#endif
+
+#ifdef OFXALEMBIC_X86
+	switch (getSimdLevel())
+	{
+		case SIMD_AVX2: gatherV3f_avx2(dst, src, idx, num, idx2); return;
+		case SIMD_SSE: gatherV3f_sse(dst, src, num_src, idx, num, idx2); return;
+		default: break;
+	}
+#endif
+
+	gatherV3f_scalar(dst, src, idx, num, idx2);
+}
+
+void ofxAlembic::gatherV2f(float* dst, const float* src, size_t num_src, const uint32_t* idx, size_t num, const uint32_t* idx2)
+{
+#ifndef NDEBUG
+	check_indices(num_src, idx, num, idx2);
+#else
+	(void)num_src;
+#endif
+
+#ifdef OFXALEMBIC_X86
+	switch (getSimdLevel())
+	{
+		case SIMD_AVX2: gatherV2f_avx2(dst, src, idx, num, idx2); return;
+		case SIMD_SSE: gatherV2f_sse(dst, src, idx, num, idx2); return;
+		default: break;
+	}
+#endif
+
+	gatherV2f_scalar(dst, src, idx, num, idx2);
+}
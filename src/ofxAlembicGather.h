@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ofxAlembic
+{
+	enum SimdLevel
+	{
+		SIMD_SCALAR = 0,
+		SIMD_SSE,
+		SIMD_AVX2
+	};
+
+	// best level supported by this cpu, detected once
+	SimdLevel getSupportedSimdLevel();
+
+	// level used by the gather kernels, clamped to what the cpu supports
+	SimdLevel getSimdLevel();
+	void setSimdLevel(SimdLevel level);
+
+	const char* getSimdLevelName(SimdLevel level);
+
+	// dst[i] = src[idx[i]], or src[idx2[idx[i]]] when idx2 is given.
+	// src holds num_src packed elements of 3 (or 2) floats, debug builds assert that
+	// every index lands in it
+	void gatherV3f(float* dst, const float* src, size_t num_src, const uint32_t* idx, size_t num, const uint32_t* idx2 = NULL);
+	void gatherV2f(float* dst, const float* src, size_t num_src, const uint32_t* idx, size_t num, const uint32_t* idx2 = NULL);
+}
@@ -0,0 +1,305 @@
+#include "ofxAlembicIndex.h"
+#include "ofxAlembicReader.h"
+
+#include <fstream>
+#include <cstring>
+#include <sys/stat.h>
+
+using namespace ofxAlembic;
+using namespace Alembic::AbcGeom;
+
+static const char MAGIC[8] = { 'A', 'B', 'C', 'I', 'D', 'X', 0, 0 };
+static const uint32_t VERSION = 3;
+static const size_t HASH_BLOCK = 64 * 1024;
+
+#pragma mark - io helpers
+
+template <typename T>
+static void write(std::ofstream& out, const T& v)
+{
+	out.write((const char*)&v, sizeof(T));
+}
+
+static void write(std::ofstream& out, const string& s)
+{
+	write(out, (uint32_t)s.size());
+	out.write(s.data(), s.size());
+}
+
+template <typename T>
+static bool read(std::ifstream& in, T& v)
+{
+	return (bool)in.read((char*)&v, sizeof(T));
+}
+
+static bool read(std::ifstream& in, string& s)
+{
+	uint32_t size;
+	if (!read(in, size) || size > (1 << 20)) return false;
+
+	s.resize(size);
+	return size == 0 || (bool)in.read(&s[0], size);
+}
+
+// 64 bit fnv-1a
+static uint64_t fnv1a(const char* data, size_t size, uint64_t h)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		h ^= (unsigned char)data[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+template <typename T>
+static Imath::Box3d read_self_bounds(T& schema)
+{
+	IBox3dProperty prop = schema.getSelfBoundsProperty();
+	if (!prop || prop.getNumSamples() == 0) return Imath::Box3d();
+
+	return prop.getValue(ISampleSelector((index_t)0));
+}
+
+#pragma mark - ArchiveIndex
+
+bool ArchiveIndex::makeKey(const string& path, Key& key)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) return false;
+
+	key.size = st.st_size;
+	key.mtime = st.st_mtime;
+
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in) return false;
+
+	// head and tail catch rewrites that keep size and mtime
+	vector<char> block(HASH_BLOCK);
+	uint64_t h = 14695981039346656037ULL;
+
+	in.read(block.data(), block.size());
+	h = fnv1a(block.data(), in.gcount(), h);
+
+	if (key.size > HASH_BLOCK)
+	{
+		in.clear();
+		in.seekg(std::max<int64_t>(key.size - HASH_BLOCK, HASH_BLOCK));
+		in.read(block.data(), block.size());
+		h = fnv1a(block.data(), in.gcount(), h);
+	}
+
+	key.hash = h;
+	return true;
+}
+
+bool ArchiveIndex::load(const string& path, const Key& expected)
+{
+	clear();
+
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in) return false;
+
+	char magic[8];
+	uint32_t version;
+	if (!in.read(magic, 8) || memcmp(magic, MAGIC, 8) != 0) return false;
+	if (!read(in, version) || version != VERSION) return false;
+
+	Key k;
+	if (!read(in, k.size) || !read(in, k.mtime) || !read(in, k.hash)) return false;
+	if (k != expected) return false;
+
+	uint64_t num;
+	// an archive can't hold more objects than bytes, anything else is garbage
+	if (!read(in, num) || num > k.size) return false;
+
+	entries.resize(num);
+	for (size_t i = 0; i < num; i++)
+	{
+		Entry &e = entries[i];
+
+		int32_t parent;
+		uint8_t type, constant;
+		uint64_t num_samples;
+		double b[6];
+
+		bool ok = read(in, e.fullname)
+			&& read(in, parent)
+			&& read(in, type)
+			&& read(in, constant)
+			&& read(in, num_samples)
+			&& read(in, e.min_time)
+			&& read(in, e.max_time)
+			&& read(in, b)
+			&& read(in, e.xform)
+			&& read(in, e.time_sampling);
+
+		// the top object is never indexed, so every node is a known type
+		if (!ok || type >= UNKHOWN || parent < -1 || parent >= (int32_t)i)
+		{
+			clear();
+			return false;
+		}
+
+		e.parent = parent;
+		e.type = (Type)type;
+		e.constant = constant != 0;
+		e.num_samples = num_samples;
+		e.bounds = Imath::Box3d(Imath::V3d(b[0], b[1], b[2]), Imath::V3d(b[3], b[4], b[5]));
+	}
+
+	key = k;
+	updateLookup();
+
+	return true;
+}
+
+bool ArchiveIndex::save(const string& path) const
+{
+	std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!out) return false;
+
+	out.write(MAGIC, 8);
+	write(out, VERSION);
+
+	write(out, key.size);
+	write(out, key.mtime);
+	write(out, key.hash);
+
+	write(out, (uint64_t)entries.size());
+	for (int i = 0; i < entries.size(); i++)
+	{
+		const Entry &e = entries[i];
+		const Imath::Box3d &b = e.bounds;
+		const double bounds[6] = { b.min.x, b.min.y, b.min.z, b.max.x, b.max.y, b.max.z };
+
+		write(out, e.fullname);
+		write(out, (int32_t)e.parent);
+		write(out, (uint8_t)e.type);
+		write(out, (uint8_t)e.constant);
+		write(out, (uint64_t)e.num_samples);
+		write(out, e.min_time);
+		write(out, e.max_time);
+		write(out, bounds);
+		write(out, e.xform);
+		write(out, e.time_sampling);
+	}
+
+	return (bool)out;
+}
+
+void ArchiveIndex::build(const Scene& scene, IArchive& archive, const Key& k)
+{
+	clear();
+
+	key = k;
+
+	// node 0 is the top object, which the archive always has
+	for (size_t i = 1; i < scene.size(); i++)
+	{
+		IGeom *o = scene.getGeom(i);
+
+		Entry e;
+		e.fullname = o->getFullName();
+		e.parent = scene.getParent(i) - 1;
+		e.type = scene.getType(i);
+		e.constant = o->m_constant;
+		e.num_samples = o->m_numSamples;
+		e.min_time = o->m_minTime;
+		e.max_time = o->m_maxTime;
+		e.time_sampling = 0;
+
+		if (e.type == XFORM)
+		{
+			ofxAlembic::IXform *x = (ofxAlembic::IXform*)o;
+			e.xform = x->xform.mat;
+
+			for (uint32_t t = 0; t < archive.getNumTimeSamplings(); t++)
+			{
+				if (*archive.getTimeSampling(t) == *x->m_timeSampling)
+				{
+					e.time_sampling = t;
+					break;
+				}
+			}
+		}
+		else if (e.type == POINTS)
+			e.bounds = read_self_bounds(((ofxAlembic::IPoints*)o)->m_points.getSchema());
+		else if (e.type == CURVES)
+			e.bounds = read_self_bounds(((ofxAlembic::ICurves*)o)->m_curves.getSchema());
+		else if (e.type == POLYMESH)
+			e.bounds = read_self_bounds(((ofxAlembic::IPolyMesh*)o)->m_polyMesh.getSchema());
+
+		entries.push_back(e);
+	}
+
+	updateLookup();
+}
+
+ofPtr<IGeom> ArchiveIndex::restore(IArchive& archive) const
+{
+	ofPtr<IGeom> root(new IGeom());
+	root->m_object = archive.getTop();
+
+	vector<IGeom*> nodes(entries.size());
+
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const Entry &e = entries[i];
+		IGeom *parent = e.parent < 0 ? root.get() : nodes[e.parent];
+
+		ofPtr<IGeom> o;
+
+		if (e.type == XFORM)
+		{
+			if (e.time_sampling >= archive.getNumTimeSamplings()) return ofPtr<IGeom>();
+			o.reset(new ofxAlembic::IXform(e, parent, archive.getTimeSampling(e.time_sampling)));
+		}
+		else if (e.type == POINTS)
+			o.reset(new ofxAlembic::IPoints(e, parent));
+		else if (e.type == CURVES)
+			o.reset(new ofxAlembic::ICurves(e, parent));
+		else if (e.type == POLYMESH)
+			o.reset(new ofxAlembic::IPolyMesh(e, parent));
+		else if (e.type == CAMERA)
+			o.reset(new ofxAlembic::ICamera(e, parent));
+		else
+			return ofPtr<IGeom>();
+
+		o->index = parent->m_children.size();
+		parent->m_children.push_back(o);
+		nodes[i] = o.get();
+	}
+
+	// entries hold the merged ranges, only the top needs its direct children
+	for (size_t i = 0; i < root->m_children.size(); i++)
+	{
+		IGeom *o = root->m_children[i].get();
+		root->m_minTime = std::min(root->m_minTime, o->m_minTime);
+		root->m_maxTime = std::max(root->m_maxTime, o->m_maxTime);
+	}
+
+	return root;
+}
+
+void ArchiveIndex::clear()
+{
+	key = Key();
+	entries.clear();
+	lookup.clear();
+}
+
+const ArchiveIndex::Entry* ArchiveIndex::find(const string& fullname) const
+{
+	std::unordered_map<string, size_t>::const_iterator it = lookup.find(fullname);
+	return it != lookup.end() ? &entries[it->second] : NULL;
+}
+
+void ArchiveIndex::updateLookup()
+{
+	lookup.clear();
+	lookup.reserve(entries.size());
+
+	for (int i = 0; i < entries.size(); i++)
+		lookup[entries[i].fullname] = i;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "ofxAlembicUtil.h"
+
+namespace ofxAlembic
+{
+class ArchiveIndex;
+class Scene;
+class IGeom;
+}
+
+// hierarchy, types, time ranges and bounds of an archive, cached next to it as <file>.abcidx.
+// a re-open builds the object tree from it without walking the archive, objects are opened
+// when a leaf is loaded or an animated xform is first read
+
+class ofxAlembic::ArchiveIndex
+{
+public:
+
+	struct Key
+	{
+		uint64_t size;
+		int64_t mtime;
+		uint64_t hash; // of the first and last 64KB
+
+		Key() : size(0), mtime(0), hash(0) {}
+
+		inline bool operator==(const Key& o) const { return size == o.size && mtime == o.mtime && hash == o.hash; }
+		inline bool operator!=(const Key& o) const { return !(*this == o); }
+	};
+
+	// depth first, parents come before their children
+	struct Entry
+	{
+		string fullname;
+		int parent; // entry index, -1 below the top object
+		Type type;
+		bool constant;
+		size_t num_samples;
+		double min_time;
+		double max_time;
+		Imath::Box3d bounds; // self bounds of the first sample, empty for xforms or when not written
+		Imath::M44f xform; // local matrix of constant xforms
+		uint32_t time_sampling; // archive time sampling of xforms
+	};
+
+	// path is a file system path, false if the file can't be read
+	static bool makeKey(const string& path, Key& key);
+	static string getIndexPath(const string& path) { return path + ".abcidx"; }
+
+	// false when missing, corrupt or written for another version of the archive
+	bool load(const string& path, const Key& key);
+	bool save(const string& path) const;
+
+	// reads the bounds from the leaf schemas, hold the HDF5 lock
+	void build(const Scene& scene, Alembic::AbcGeom::IArchive& archive, const Key& key);
+	void clear();
+
+	// the top object of archive with the indexed tree below it, nothing else is read.
+	// NULL when archive doesn't match the index
+	ofPtr<IGeom> restore(Alembic::AbcGeom::IArchive& archive) const;
+
+	const Entry* find(const string& fullname) const;
+
+	inline size_t size() const { return entries.size(); }
+	inline const Entry& getEntry(size_t i) const { return entries[i]; }
+	inline const Key& getKey() const { return key; }
+
+protected:
+
+	Key key;
+	vector<Entry> entries;
+	std::unordered_map<string, size_t> lookup;
+
+	void updateLookup();
+};
@@ -0,0 +1,264 @@
+#include "ofxAlembicPrefetcher.h"
+
+using namespace ofxAlembic;
+using namespace Alembic::AbcGeom;
+
+Prefetcher::Prefetcher(const vector<IGeom*>& leaves, double min_time, double max_time, bool hdf5, size_t num_frames, size_t max_bytes)
+	: min_time(min_time)
+	, max_time(max_time)
+	, hdf5(hdf5)
+	, num_frames(num_frames)
+	, max_bytes(max_bytes)
+	, running(true)
+	, has_playhead(false)
+	, playhead(0)
+	, direction(1)
+	, generation(0)
+	, bytes(0)
+	, hits(0)
+	, misses(0)
+{
+	slots.resize(leaves.size());
+
+	for (int i = 0; i < leaves.size(); i++)
+	{
+		if (!leaves[i] || !leaves[i]->isAnimated()) continue;
+
+		slots[i].geom = leaves[i];
+		slots[i].num_samples = leaves[i]->getNumSamples();
+	}
+
+	thread = std::thread(&Prefetcher::threadLoop, this);
+}
+
+Prefetcher::~Prefetcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	cond.notify_all();
+
+	thread.join();
+}
+
+void Prefetcher::setTime(double time)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (has_playhead)
+		{
+			double d = time - playhead;
+			double half_range = (max_time - min_time) * 0.5;
+
+			if (d == 0) return;
+
+			if (d < -half_range) direction = 1; // wrapped past the end
+			else if (d > half_range) direction = -1; // wrapped past the start
+			else direction = d > 0 ? 1 : -1;
+		}
+
+		playhead = time;
+		has_playhead = true;
+		generation++;
+	}
+
+	cond.notify_one();
+}
+
+ofPtr<SampleData> Prefetcher::take(size_t leaf, index_t index)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Slot &slot = slots[leaf];
+	for (int i = 0; i < slot.ready.size(); i++)
+	{
+		if (slot.ready[i]->index != index) continue;
+
+		ofPtr<SampleData> data = slot.ready[i];
+		slot.ready.erase(slot.ready.begin() + i);
+		bytes -= data->getMemoryUsage();
+		hits++;
+
+		return data;
+	}
+
+	misses++;
+	return ofPtr<SampleData>();
+}
+
+void Prefetcher::recycle(size_t leaf, const ofPtr<SampleData>& data)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Slot &slot = slots[leaf];
+	if (slot.spare) return;
+
+	const size_t size = data->getMemoryUsage();
+	if (bytes + size > max_bytes) return;
+
+	slot.spare = data;
+	bytes += size;
+}
+
+size_t Prefetcher::getHits() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return hits;
+}
+
+size_t Prefetcher::getMisses() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return misses;
+}
+
+size_t Prefetcher::getMemoryUsage() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return bytes;
+}
+
+void Prefetcher::threadLoop()
+{
+	size_t seen = 0;
+
+	while (true)
+	{
+		double time;
+		int dir;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [&]() { return !running || generation != seen; });
+
+			if (!running) break;
+
+			seen = generation;
+			time = playhead;
+			dir = direction;
+
+			prune(time, dir);
+		}
+
+		fill(time, dir, seen);
+	}
+}
+
+void Prefetcher::prune(double time, int dir)
+{
+	// drop everything that fell out of the window ahead of the playhead
+	for (int i = 0; i < slots.size(); i++)
+	{
+		Slot &slot = slots[i];
+		if (slot.geom == NULL || slot.ready.empty()) continue;
+
+		index_t current = slot.geom->getSampleIndex(time);
+		const index_t n = slot.num_samples;
+
+		std::deque<ofPtr<SampleData> >::iterator it = slot.ready.begin();
+		while (it != slot.ready.end())
+		{
+			index_t offset = dir > 0 ? ((*it)->index - current + n) % n : (current - (*it)->index + n) % n;
+
+			if (offset >= 1 && offset <= num_frames)
+			{
+				it++;
+				continue;
+			}
+
+			// becoming the spare keeps it counted
+			if (slot.spare)
+				bytes -= (*it)->getMemoryUsage();
+			else
+				slot.spare = *it;
+
+			it = slot.ready.erase(it);
+		}
+	}
+}
+
+void Prefetcher::fill(double time, int dir, size_t gen)
+{
+	vector<index_t> current(slots.size(), -1);
+	for (int i = 0; i < slots.size(); i++)
+	{
+		if (slots[i].geom && slots[i].geom->m_loaded)
+			current[i] = slots[i].geom->getSampleIndex(time);
+	}
+
+	// nearest frames first across all objects, then further ahead
+	for (int k = 1; k <= num_frames; k++)
+	{
+		for (int i = 0; i < slots.size(); i++)
+		{
+			Slot &slot = slots[i];
+			if (slot.geom == NULL || k >= slot.num_samples) continue;
+
+			// lazy leaves build their topology on load, don't read before that
+			if (!slot.geom->m_loaded) continue;
+
+			index_t index = offsetIndex(slot, current[i], dir * k);
+			ofPtr<SampleData> data;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				// playhead moved, start over from the new position
+				if (!running || generation != gen) return;
+
+				// decoding into the spare reuses what it already counts, otherwise
+				// assume the sample is as large as the last one
+				const size_t reused = slot.spare ? slot.spare->getMemoryUsage() : 0;
+				const size_t needed = slot.spare ? reused : slot.sample_bytes;
+				if (bytes - reused + needed > max_bytes) return;
+
+				bool found = false;
+				for (int j = 0; j < slot.ready.size(); j++)
+				{
+					if (slot.ready[j]->index == index)
+					{
+						found = true;
+						break;
+					}
+				}
+				if (found) continue;
+
+				data = slot.spare;
+				slot.spare.reset();
+				bytes -= reused;
+			}
+
+			{
+				std::unique_lock<std::recursive_mutex> lock(getHDF5Mutex(), std::defer_lock);
+				if (hdf5) lock.lock();
+
+				try
+				{
+					data = slot.geom->readSample(index, data);
+				}
+				catch (std::exception &e)
+				{
+					ofLogError("ofxAlembic::Prefetcher") << e.what();
+					data.reset();
+				}
+			}
+
+			if (!data) continue;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				slot.ready.push_back(data);
+				slot.sample_bytes = data->getMemoryUsage();
+				bytes += slot.sample_bytes;
+			}
+		}
+	}
+}
+
+index_t Prefetcher::offsetIndex(const Slot& slot, index_t index, int offset) const
+{
+	const index_t n = slot.num_samples;
+	return ((index + offset) % n + n) % n;
+}
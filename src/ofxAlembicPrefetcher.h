@@ -0,0 +1,79 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+#include "ofxAlembicReader.h"
+
+namespace ofxAlembic
+{
+class Prefetcher;
+}
+
+// background read-ahead for linear playback, keeps the next num_frames samples
+// of every animated leaf decoded in a small ring per object
+
+class ofxAlembic::Prefetcher
+{
+public:
+
+	// NULL leaves are never read ahead
+	Prefetcher(const vector<IGeom*>& leaves, double min_time, double max_time, bool hdf5, size_t num_frames, size_t max_bytes);
+	~Prefetcher();
+
+	// moves the playhead, direction and wrap-around are derived from the previous call
+	void setTime(double time);
+
+	// returns the decoded sample if it is ready, counts a hit or a miss
+	ofPtr<SampleData> take(size_t leaf, Alembic::AbcGeom::index_t index);
+
+	// hands back a consumed buffer so the worker can decode into it again,
+	// it is freed when keeping it would go over max_bytes
+	void recycle(size_t leaf, const ofPtr<SampleData>& data);
+
+	size_t getHits() const;
+	size_t getMisses() const;
+	// decoded samples waiting to be taken plus the spare buffers
+	size_t getMemoryUsage() const;
+
+protected:
+
+	struct Slot
+	{
+		IGeom *geom;
+		size_t num_samples;
+		std::deque<ofPtr<SampleData> > ready;
+		ofPtr<SampleData> spare;
+		size_t sample_bytes; // size of the last decoded sample, to check the cap before decoding
+
+		Slot() : geom(NULL), num_samples(0), sample_bytes(0) {}
+	};
+
+	vector<Slot> slots;
+
+	double min_time, max_time;
+	bool hdf5;
+	size_t num_frames;
+	size_t max_bytes;
+
+	mutable std::mutex mutex;
+	std::condition_variable cond;
+	std::thread thread;
+
+	bool running;
+	bool has_playhead;
+	double playhead;
+	int direction;
+	size_t generation;
+
+	size_t bytes;
+	size_t hits, misses;
+
+	void threadLoop();
+	void prune(double time, int dir);
+	void fill(double time, int dir, size_t gen);
+
+	Alembic::AbcGeom::index_t offsetIndex(const Slot& slot, Alembic::AbcGeom::index_t index, int offset) const;
+};
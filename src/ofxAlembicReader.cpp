@@ -1,14 +1,59 @@
 #include "ofxAlembicReader.h"
+#include "ofxAlembicPrefetcher.h"
+#include "ofxAlembicFrameCache.h"
+#include "ofxAlembicSnapshot.h"
+#include "ofxAlembicAsync.h"
 
 using namespace ofxAlembic;
 using namespace Alembic::AbcGeom;
 
+// guards the objects that nodes built from the sidecar index open on first use
+static std::recursive_mutex& open_mutex()
+{
+	static std::recursive_mutex mutex;
+	return mutex;
+}
+
+// times that resolve to the same sample share one read, the first time of each group decodes
+template <typename T>
+static void group_times(T& schema, const View<double>& times, vector<index_t>& samples, vector<vector<size_t> >& groups)
+{
+	std::map<index_t, size_t> lookup;
+
+	for (size_t k = 0; k < times.size(); k++)
+	{
+		ISampleSelector ss(times[k], ISampleSelector::kNearIndex);
+		index_t index = ss.getIndex(schema.getTimeSampling(), schema.getNumSamples());
+
+		std::map<index_t, size_t>::iterator it = lookup.find(index);
+		if (it == lookup.end())
+		{
+			it = lookup.insert(make_pair(index, samples.size())).first;
+			samples.push_back(index);
+			groups.push_back(vector<size_t>());
+		}
+
+		groups[it->second].push_back(k);
+	}
+}
+
+template <typename F>
+static void for_groups(ThreadPool* pool, size_t num, F fn)
+{
+	if (pool)
+		pool->parallelFor(0, num, fn);
+	else
+		for (size_t i = 0; i < num; i++)
+			fn(i);
+}
+
 #pragma mark - IXform
 
-ofxAlembic::IXform::IXform(Alembic::AbcGeom::IXform object) : ofxAlembic::IGeom(object), m_xform(object)
+ofxAlembic::IXform::IXform(Alembic::AbcGeom::IXform object) : ofxAlembic::IGeom(object), m_xform(object), m_wrapped(true)
 {
 	update_timestamp(m_xform);
 	type = XFORM;
+	m_timeSampling = m_xform.getSchema().getTimeSampling();
 	
 	if (m_xform.getSchema().isConstant())
 	{
@@ -20,192 +65,1311 @@ ofxAlembic::IXform::IXform(Alembic::AbcGeom::IXform object) : ofxAlembic::IGeom(
 	}
 }
 
-ofxAlembic::IXform::~IXform()
-{
-	if (m_xform)
-		m_xform.reset();
+ofxAlembic::IXform::IXform(const ArchiveIndex::Entry& entry, IGeom* parent, TimeSamplingPtr time_sampling) : ofxAlembic::IGeom(entry, parent), m_timeSampling(time_sampling), m_wrapped(false)
+{
+	type = XFORM;
+	xform.mat = entry.xform;
+}
+
+ofxAlembic::IXform::~IXform()
+{
+	if (m_xform)
+		m_xform.reset();
+}
+
+IXformSchema& ofxAlembic::IXform::getSchema()
+{
+	if (!m_wrapped)
+	{
+		std::lock_guard<std::recursive_mutex> lock(open_mutex());
+
+		if (!m_wrapped)
+		{
+			m_xform = Alembic::AbcGeom::IXform(object(), kWrapExisting);
+			m_wrapped = true;
+		}
+	}
+
+	return m_xform.getSchema();
+}
+
+#pragma mark - IPoints
+
+ofxAlembic::IPoints::IPoints(Alembic::AbcGeom::IPoints object) : ofxAlembic::IGeom(object), m_points(object)
+{
+	update_timestamp(m_points);
+	type = POINTS;
+	m_loaded = false;
+}
+
+ofxAlembic::IPoints::IPoints(const ArchiveIndex::Entry& entry, IGeom* parent) : ofxAlembic::IGeom(entry, parent)
+{
+	type = POINTS;
+	m_loaded = false;
+}
+
+void ofxAlembic::IPoints::load()
+{
+	if (!m_points)
+		m_points = Alembic::AbcGeom::IPoints(object(), kWrapExisting);
+	
+	if (m_points.getSchema().isConstant())
+	{
+		points.set(m_points.getSchema(), m_minTime);
+	}
+	
+	m_loaded = true;
+}
+
+bool ofxAlembic::IPoints::updateWithTimeInternal(double time, Imath::M44f& xform)
+{
+	if (m_points.getSchema().isConstant()) return false;
+	if (!update_sample_index(m_points.getSchema(), time)) return false;
+	
+	points.set(m_points.getSchema(), ISampleSelector(m_sampleIndex));
+	return true;
+}
+
+bool ofxAlembic::IPoints::evaluate(const View<double>& times, glm::vec3* positions, ThreadPool* pool)
+{
+	const size_t n = points.points.size();
+
+	if (m_constant)
+	{
+		for (size_t k = 0; k < times.size(); k++)
+			for (size_t i = 0; i < n; i++)
+				positions[k * n + i] = points.points[i].pos;
+		return true;
+	}
+
+	IPointsSchema &schema = m_points.getSchema();
+
+	vector<index_t> samples;
+	vector<vector<size_t> > groups;
+	group_times(schema, times, samples, groups);
+
+	std::atomic<bool> ok(true);
+
+	for_groups(pool, groups.size(), [&](size_t g)
+	{
+		P3fArraySamplePtr P = schema.getPositionsProperty().getValue(ISampleSelector(samples[g]));
+		if (P->size() != n)
+		{
+			ok = false;
+			return;
+		}
+
+		glm::vec3 *dst = positions + groups[g][0] * n;
+		const V3f *src = P->get();
+		for (size_t i = 0; i < n; i++)
+			dst[i] = glm::vec3(src[i].x, src[i].y, src[i].z);
+
+		for (size_t j = 1; j < groups[g].size(); j++)
+			std::copy(dst, dst + n, positions + groups[g][j] * n);
+	});
+
+	if (!ok)
+		ofLogError("ofxAlembic::IPoints") << "point count changes over time: " << getName();
+
+	return ok;
+}
+
+ofPtr<SampleData> ofxAlembic::IPoints::readSample(index_t index, ofPtr<SampleData> data)
+{
+	return read_sample<Points>(m_points.getSchema(), index, data);
+}
+
+void ofxAlembic::IPoints::swapSample(ofPtr<SampleData>& data)
+{
+	swap_sample(points, data);
+}
+
+#pragma mark - ICurves
+
+ofxAlembic::ICurves::ICurves(Alembic::AbcGeom::ICurves object) : ofxAlembic::IGeom(object), m_curves(object)
+{
+	update_timestamp(m_curves);
+	type = CURVES;
+	m_loaded = false;
+}
+
+ofxAlembic::ICurves::ICurves(const ArchiveIndex::Entry& entry, IGeom* parent) : ofxAlembic::IGeom(entry, parent)
+{
+	type = CURVES;
+	m_loaded = false;
+}
+
+void ofxAlembic::ICurves::load()
+{
+	if (!m_curves)
+		m_curves = Alembic::AbcGeom::ICurves(object(), kWrapExisting);
+	
+	if (m_curves.getSchema().isConstant())
+	{
+		curves.set(m_curves.getSchema(), m_minTime);
+	}
+	
+	m_loaded = true;
+}
+
+bool ofxAlembic::ICurves::updateWithTimeInternal(double time, Imath::M44f& xform)
+{
+	if (m_curves.getSchema().isConstant()) return false;
+	if (!update_sample_index(m_curves.getSchema(), time)) return false;
+	
+	curves.set(m_curves.getSchema(), ISampleSelector(m_sampleIndex));
+	return true;
+}
+
+ofPtr<SampleData> ofxAlembic::ICurves::readSample(index_t index, ofPtr<SampleData> data)
+{
+	return read_sample<Curves>(m_curves.getSchema(), index, data);
+}
+
+void ofxAlembic::ICurves::swapSample(ofPtr<SampleData>& data)
+{
+	swap_sample(curves, data);
+}
+
+#pragma mark - IPolyMesh
+
+ofxAlembic::IPolyMesh::IPolyMesh(Alembic::AbcGeom::IPolyMesh object) : ofxAlembic::IGeom(object), m_polyMesh(object), m_pool(NULL)
+{
+	update_timestamp(m_polyMesh);
+	type = POLYMESH;
+	m_loaded = false;
+	
+	m_topology.indexed = false;
+}
+
+ofxAlembic::IPolyMesh::IPolyMesh(const ArchiveIndex::Entry& entry, IGeom* parent) : ofxAlembic::IGeom(entry, parent), m_pool(NULL)
+{
+	type = POLYMESH;
+	m_loaded = false;
+	
+	m_topology.indexed = false;
+}
+
+void ofxAlembic::IPolyMesh::setIndexed(bool indexed)
+{
+	m_topology.indexed = indexed;
+	
+	if (m_loaded)
+		load();
+}
+
+void ofxAlembic::IPolyMesh::load()
+{
+	if (!m_polyMesh)
+		m_polyMesh = Alembic::AbcGeom::IPolyMesh(object(), kWrapExisting);
+	
+	IPolyMeshSchema &schema = m_polyMesh.getSchema();
+	bool indexed = m_topology.indexed;
+	
+	m_topology = MeshTopology();
+	m_topology.indexed = indexed;
+	m_sampleIndex = -1;
+	
+	if (schema.isConstant())
+	{
+		polymesh.set(schema, ISampleSelector(m_minTime, ISampleSelector::kNearIndex), m_topology, m_pool);
+	}
+	else if (schema.getTopologyVariance() == kHomogenousTopology && schema.getNumSamples() > 0)
+	{
+		// triangulate once, later samples only scatter P through the cached remap
+		ISampleSelector ss((index_t)0);
+		m_topology.build(schema.getPositionsProperty().getValue(ss)->size(),
+						 schema.getFaceIndicesProperty().getValue(ss),
+						 schema.getFaceCountsProperty().getValue(ss),
+						 m_pool);
+		
+		if (indexed)
+			m_topology.weld(schema, ss);
+	}
+	
+	m_loaded = true;
+}
+
+bool ofxAlembic::IPolyMesh::updateWithTimeInternal(double time, Imath::M44f& xform)
+{
+	if (m_polyMesh.getSchema().isConstant()) return false;
+	if (!update_sample_index(m_polyMesh.getSchema(), time)) return false;
+	
+	polymesh.set(m_polyMesh.getSchema(), ISampleSelector(m_sampleIndex), m_topology, m_pool);
+	return true;
+}
+
+size_t ofxAlembic::IPolyMesh::getNumEvaluatedVertices() const
+{
+	return m_topology.empty() ? polymesh.mesh.getNumVertices() : m_topology.getNumVertices();
+}
+
+bool ofxAlembic::IPolyMesh::evaluate(const View<double>& times, glm::vec3* positions, glm::vec3* normals, ThreadPool* pool)
+{
+	const size_t n = getNumEvaluatedVertices();
+
+	// the archive decides whether there are normals, same check as PolyMesh::evaluate
+	IN3fGeomParam N = m_polyMesh.getSchema().getNormalsParam();
+	if (normals && (!N.valid() || N.isIndexed()))
+	{
+		ofLogError("ofxAlembic::IPolyMesh") << "no normals to evaluate: " << getName();
+		return false;
+	}
+
+	if (m_constant)
+	{
+		const vector<glm::vec3> &v = polymesh.mesh.getVertices();
+		const vector<glm::vec3> &nv = polymesh.mesh.getNormals();
+
+		for (size_t k = 0; k < times.size(); k++)
+		{
+			std::copy(v.begin(), v.end(), positions + k * n);
+			if (normals)
+				std::copy(nv.begin(), nv.end(), normals + k * n);
+		}
+		return true;
+	}
+
+	if (m_topology.empty())
+	{
+		ofLogError("ofxAlembic::IPolyMesh") << "evaluate needs homogeneous topology: " << getName();
+		return false;
+	}
+
+	IPolyMeshSchema &schema = m_polyMesh.getSchema();
+
+	vector<index_t> samples;
+	vector<vector<size_t> > groups;
+	group_times(schema, times, samples, groups);
+
+	std::atomic<bool> ok(true);
+
+	for_groups(pool, groups.size(), [&](size_t g)
+	{
+		const size_t first = groups[g][0];
+		glm::vec3 *p = positions + first * n;
+		glm::vec3 *nv = normals ? normals + first * n : NULL;
+
+		// the triangulation built at load serves every sample
+		if (!PolyMesh::evaluate(schema, ISampleSelector(samples[g]), m_topology, p, nv, pool))
+		{
+			ok = false;
+			return;
+		}
+
+		for (size_t j = 1; j < groups[g].size(); j++)
+		{
+			std::copy(p, p + n, positions + groups[g][j] * n);
+			if (nv) std::copy(nv, nv + n, normals + groups[g][j] * n);
+		}
+	});
+
+	if (!ok)
+		ofLogError("ofxAlembic::IPolyMesh") << "point count changed on a homogeneous mesh: " << getName();
+
+	return ok;
+}
+
+ofPtr<SampleData> ofxAlembic::IPolyMesh::readSample(index_t index, ofPtr<SampleData> data)
+{
+	TypedSampleData<PolyMesh> *typed = sample_buffer<PolyMesh>(data);
+	typed->value.set(m_polyMesh.getSchema(), ISampleSelector(index), m_topology, m_pool);
+	typed->index = index;
+	
+	return data;
+}
+
+void ofxAlembic::IPolyMesh::swapSample(ofPtr<SampleData>& data)
+{
+	swap_sample(polymesh, data);
+}
+
+#pragma mark - ICamera
+
+ofxAlembic::ICamera::ICamera(Alembic::AbcGeom::ICamera object) : ofxAlembic::IGeom(object), m_camera(object)
+{
+	update_timestamp(m_camera);
+	type = CAMERA;
+	m_loaded = false;
+}
+
+ofxAlembic::ICamera::ICamera(const ArchiveIndex::Entry& entry, IGeom* parent) : ofxAlembic::IGeom(entry, parent)
+{
+	type = CAMERA;
+	m_loaded = false;
+}
+
+void ofxAlembic::ICamera::load()
+{
+	if (!m_camera)
+		m_camera = Alembic::AbcGeom::ICamera(object(), kWrapExisting);
+	
+	if (m_camera.getSchema().isConstant())
+	{
+		camera.set(m_camera.getSchema(), m_minTime);
+	}
+	
+	m_loaded = true;
+}
+
+bool ofxAlembic::ICamera::updateWithTimeInternal(double time, Imath::M44f& xform)
+{
+	if (m_camera.getSchema().isConstant()) return false;
+	if (!update_sample_index(m_camera.getSchema(), time)) return false;
+	
+	camera.set(m_camera.getSchema(), ISampleSelector(m_sampleIndex));
+	return true;
+}
+
+ofPtr<SampleData> ofxAlembic::ICamera::readSample(index_t index, ofPtr<SampleData> data)
+{
+	return read_sample<Camera>(m_camera.getSchema(), index, data);
+}
+
+void ofxAlembic::ICamera::swapSample(ofPtr<SampleData>& data)
+{
+	swap_sample(camera, data);
+}
+
+#pragma mark - Reader
+
+bool ofxAlembic::Reader::open(const string& path, size_t num_streams)
+{
+	ofxAlembic::init();
+	
+	if (!ofFile::doesFileExist(path))
+	{
+		ofLogError("ofxAlembic") << "file not found: " << path;
+		return false;
+	}
+
+	// pending requests are for the old archive
+	m_async.reset();
+
+	// the worker reads the tree that is replaced below, and takes the HDF5 lock while
+	// doing so, stop it before locking
+	m_prefetcher.reset();
+
+	// constant samples are decoded while building the tree, keep HDF5 out of other threads meanwhile
+	std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+
+	m_num_streams = std::max<size_t>(num_streams, 1);
+
+	resetSnapshots();
+
+	m_archive = IArchive(Alembic::AbcCoreHDF5::ReadArchive(), ofToDataPath(path),
+                         Alembic::Abc::ErrorHandler::kQuietNoopPolicy);
+	m_hdf5 = m_archive.valid();
+    if (!m_archive.valid()) {
+        m_archive = IArchive(Alembic::AbcCoreOgawa::ReadArchive(m_num_streams), ofToDataPath(path),
+                             Alembic::Abc::ErrorHandler::kNoisyNoopPolicy);
+        if (!m_archive.valid()) return false;
+    }
+
+	const string file = ofToDataPath(path);
+
+	ArchiveIndex::Key key;
+	bool has_key = false;
+
+	m_index.reset();
+	m_index_hit = false;
+
+	if (m_sidecar_index)
+	{
+		has_key = ArchiveIndex::makeKey(file, key);
+
+		ofPtr<ArchiveIndex> index(new ArchiveIndex());
+		if (has_key && index->load(ArchiveIndex::getIndexPath(file), key))
+		{
+			m_index = index;
+			m_index_hit = true;
+		}
+	}
+
+	// a hit builds the tree without touching the archive, objects are opened when read
+	ofPtr<IGeom> root;
+	if (m_index)
+		root = m_index->restore(m_archive);
+
+	if (!root)
+	{
+		if (m_index)
+			ofLogWarning("ofxAlembic") << "index doesn't match the archive, rebuilding: " << ArchiveIndex::getIndexPath(file);
+
+		m_index.reset();
+		m_index_hit = false;
+
+		root = ofPtr<IGeom>(new IGeom(m_archive.getTop()));
+	}
+
+	m_root = root;
+
+	m_scene.build(m_root.get());
+
+	{
+		object_arr.clear();
+		object_name_arr.clear();
+		object_fullname_arr.clear();
+		object_name_map.clear();
+		object_fullname_map.clear();
+
+		vector<IGeom*> geoms;
+		for (int i = 0; i < m_scene.size(); i++)
+		{
+			if (!m_scene.getGeom(i)->isTypeOf(UNKHOWN))
+				geoms.push_back(m_scene.getGeom(i));
+		}
+
+		// handles keep the name sorted order, duplicated short names stay next to each other
+		vector<pair<string, IGeom*> > named(geoms.size());
+		for (int i = 0; i < geoms.size(); i++)
+			named[i] = make_pair(geoms[i]->getName(), geoms[i]);
+
+		std::stable_sort(named.begin(), named.end(), [](const pair<string, IGeom*>& a, const pair<string, IGeom*>& b)
+		{
+			return a.first < b.first;
+		});
+
+		object_arr.reserve(named.size());
+		object_name_map.reserve(named.size());
+		object_fullname_map.reserve(named.size());
+
+		size_t num_duplicates = 0;
+
+		for (int i = 0; i < named.size(); i++)
+		{
+			const string fullname = named[i].second->getFullName();
+
+			object_arr.push_back(named[i].second);
+			object_name_arr.push_back(named[i].first);
+			object_fullname_arr.push_back(fullname);
+
+			if (i > 0 && named[i].first == named[i - 1].first)
+				num_duplicates++;
+
+			object_name_map.insert(make_pair(named[i].first, (Handle)i));
+			object_fullname_map[fullname] = i;
+		}
+
+		std::sort(object_fullname_arr.begin(), object_fullname_arr.end());
+
+		if (num_duplicates > 0)
+			ofLogWarning("ofxAlembic") << num_duplicates << " duplicated object names, use full paths to tell them apart";
+	}
+
+	m_minTime = m_root->m_minTime;
+	m_maxTime = m_root->m_maxTime;
+
+	m_leaves = m_scene.getLeaves();
+
+	for (int i = 0; i < m_scene.size(); i++)
+		m_scene.getGeom(i)->m_snapshots = m_snapshot_buffers > 0 ? this : NULL;
+
+	if (m_sidecar_index && !m_index && has_key)
+	{
+		m_index = ofPtr<ArchiveIndex>(new ArchiveIndex());
+		m_index->build(m_scene, m_archive, key);
+
+		if (!m_index->save(ArchiveIndex::getIndexPath(file)))
+			ofLogWarning("ofxAlembic") << "can't write index: " << ArchiveIndex::getIndexPath(file);
+	}
+
+	updateThreadPool();
+
+	if (m_baked_xforms)
+		m_scene.bake(m_hdf5, m_pool.get());
+
+	// nothing is loaded yet, this only picks the output mode
+	for (int i = 0; i < m_leaves.size(); i++)
+	{
+		if (m_leaves[i]->isTypeOf(POLYMESH))
+			((IPolyMesh*)m_leaves[i])->setIndexed(m_indexed_mesh);
+	}
+
+	updateSubscriptions();
+
+	// unsubscribed leaves are left for get/find
+	if (!m_lazy)
+	{
+		if (m_pool && !m_hdf5)
+			m_pool->parallelFor(0, m_active.size(), [&](size_t i) { m_leaves[m_active[i]]->load(); });
+		else
+			for (int i = 0; i < m_active.size(); i++)
+				m_leaves[m_active[i]]->load();
+	}
+
+	if (m_cache)
+		m_cache->clear();
+
+	resetPrefetcher();
+
+	// readers get a frame as soon as the archive is open
+	if (m_snapshot_buffers > 0)
+		setTime(current_time);
+
+	return true;
+}
+
+void ofxAlembic::Reader::close()
+{
+	m_async.reset();
+
+	// the worker reads from the tree and takes the HDF5 lock, stop it before locking
+	m_prefetcher.reset();
+
+	std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+
+	resetSnapshots();
+	m_leaves.clear();
+	m_scene.clear();
+	m_index.reset();
+
+	// the rules stay for the next open, objects read by handle don't
+	m_subscribed.clear();
+	m_read.clear();
+	m_active.clear();
+	m_active_stale = false;
+	m_num_skipped = 0;
+
+	if (m_cache)
+		m_cache->clear();
+
+	object_arr.clear();
+	object_name_arr.clear();
+	object_fullname_arr.clear();
+	object_name_map.clear();
+	object_fullname_map.clear();
+
+	if (m_root)
+		m_root.reset();
+
+	if (m_archive.valid())
+		m_archive.reset();
+}
+
+void ofxAlembic::Reader::draw()
+{
+	if (!m_root) return;
+
+	if (m_snapshot_buffers > 0)
+	{
+		ofPtr<const Snapshot> snapshot = getSnapshot();
+		if (snapshot) snapshot->draw(m_scene);
+		return;
+	}
+
+	m_scene.draw();
+}
+
+void ofxAlembic::Reader::debugDraw()
+{
+	if (!m_root) return;
+	
+	m_scene.debugDraw();
+}
+
+void ofxAlembic::Reader::setTime(double time)
+{
+	updateTime(time);
+}
+
+bool ofxAlembic::Reader::updateTime(double time, const AsyncUpdater* async, uint64_t request)
+{
+	if (!m_root) return true;
+
+	std::lock_guard<std::recursive_mutex> lock(m_time_mutex);
+
+	// objects get subscribed since the last frame, the read-ahead follows them
+	if (m_active_stale)
+	{
+		updateActive();
+		resetPrefetcher();
+	}
+
+	// resolve the xform chain first, then decode every leaf as an independent task
+	m_num_updated = m_scene.update(time, m_hdf5, m_pool.get());
+
+	if (m_snapshot_buffers > 0)
+	{
+		// the live objects stay as they are, readers only look at published frames
+		if (!publishSnapshot(time, async, request)) return false;
+	}
+	else if (m_pool)
+	{
+		std::atomic<size_t> num_leaves_updated(0);
+
+		m_pool->parallelFor(0, m_active.size(), [&](size_t i)
+		{
+			if (updateLeaf(m_active[i], time))
+				num_leaves_updated++;
+		});
+
+		m_num_updated += num_leaves_updated;
+	}
+	else
+	{
+		for (int i = 0; i < m_active.size(); i++)
+		{
+			if (updateLeaf(m_active[i], time))
+				m_num_updated++;
+		}
+	}
+
+	if (m_prefetcher)
+		m_prefetcher->setTime(time);
+
+	current_time = time;
+	return true;
+}
+
+std::future<double> ofxAlembic::Reader::setTimeAsync(double time)
+{
+	// readers must never see a frame that is being decoded. switching modes here would
+	// decode a whole frame on the calling thread
+	if (m_snapshot_buffers == 0)
+	{
+		ofLogError("ofxAlembic") << "setTimeAsync needs snapshot mode, call setSnapshots(true) first";
+
+		std::promise<double> promise;
+		promise.set_exception(std::make_exception_ptr(std::logic_error("setTimeAsync without snapshot mode")));
+		return promise.get_future();
+	}
+
+	if (!m_async)
+		m_async = ofPtr<AsyncUpdater>(new AsyncUpdater(this));
+
+	return m_async->request(time);
+}
+
+size_t ofxAlembic::Reader::getNumCoalescedRequests() const
+{
+	return m_async ? m_async->getNumCoalesced() : 0;
+}
+
+size_t ofxAlembic::Reader::getNumCancelledRequests() const
+{
+	return m_async ? m_async->getNumCancelled() : 0;
+}
+
+bool ofxAlembic::Reader::updateLeaf(size_t i, double time)
+{
+	IGeom *o = m_leaves[i];
+
+	// lazy leaves nobody asked for yet
+	if (!o->m_loaded) return false;
+
+	if ((m_cache || m_prefetcher) && o->isAnimated())
+	{
+		index_t index = o->getSampleIndex(time);
+		if (index == o->m_sampleIndex) return false;
+
+		// already decoded in the frame cache or the read-ahead ring, just swap the buffers
+		ofPtr<SampleData> data;
+		if (m_cache) data = m_cache->take(i, index);
+		if (!data && m_prefetcher) data = m_prefetcher->take(i, index);
+
+		if (!data && m_cache && o->m_sampleIndex >= 0)
+		{
+			// decode into a new buffer so the outgoing sample can be cached
+			std::unique_lock<std::recursive_mutex> lock(getHDF5Mutex(), std::defer_lock);
+			if (m_hdf5) lock.lock();
+
+			data = o->readSample(index, data);
+		}
+
+		if (data)
+		{
+			// data holds the previous sample after the swap
+			o->swapSample(data);
+
+			if (m_cache)
+				m_cache->put(i, data);
+			else
+				m_prefetcher->recycle(i, data);
+
+			return true;
+		}
+	}
+
+	std::unique_lock<std::recursive_mutex> lock(getHDF5Mutex(), std::defer_lock);
+	if (m_hdf5) lock.lock();
+
+	Imath::M44f xform;
+	xform.makeIdentity();
+	return o->updateWithTimeInternal(time, xform);
+}
+
+#pragma mark - snapshots
+
+void ofxAlembic::Reader::setSnapshots(bool enable, size_t num_buffers)
+{
+	// async updates only exist on top of snapshots
+	if (!enable)
+		m_async.reset();
+
+	std::lock_guard<std::recursive_mutex> lock(m_time_mutex);
+
+	m_snapshot_buffers = enable ? std::max<size_t>(num_buffers, 2) : 0;
+	resetSnapshots();
+
+	if (!m_root) return;
+
+	for (int i = 0; i < m_scene.size(); i++)
+		m_scene.getGeom(i)->m_snapshots = enable ? this : NULL;
+
+	// publishes the first frame, or brings the live objects back to the current time
+	setTime(current_time);
+}
+
+ofPtr<const Snapshot> ofxAlembic::Reader::getSnapshot() const
+{
+	return std::atomic_load(&m_front);
+}
+
+void ofxAlembic::Reader::resetSnapshots()
+{
+	std::atomic_store(&m_front, ofPtr<const Snapshot>());
+	m_snapshot_stale = false;
+
+	m_snapshots.clear();
+	for (size_t i = 0; i < m_snapshot_buffers; i++)
+		m_snapshots.push_back(ofPtr<Snapshot>(new Snapshot()));
+}
+
+bool ofxAlembic::Reader::publishSnapshot(double time, const AsyncUpdater* async, uint64_t request)
+{
+	ofPtr<const Snapshot> front = getSnapshot();
+
+	// a buffer nobody holds, the front is referenced by m_front as well
+	ofPtr<Snapshot> back;
+	for (int i = 0; i < m_snapshots.size(); i++)
+	{
+		if (m_snapshots[i].use_count() == 1)
+		{
+			back = m_snapshots[i];
+			break;
+		}
+	}
+
+	if (!back)
+	{
+		// readers hold every buffer, leave the oldest one to them
+		int oldest = -1;
+		for (int i = 0; i < m_snapshots.size(); i++)
+		{
+			if (m_snapshots[i].get() == front.get()) continue;
+			if (oldest < 0 || m_snapshots[i]->frame < m_snapshots[oldest]->frame)
+				oldest = i;
+		}
+
+		back = ofPtr<Snapshot>(new Snapshot());
+		m_snapshots[oldest] = back;
+	}
+
+	back->time = time;
+	back->frame = front ? front->frame + 1 : 1;
+
+	const vector<ofMatrix4x4> &globals = m_scene.getGlobalTransforms();
+
+	if (front && m_scene.getNumRecomputed() == 0 && !m_snapshot_stale)
+	{
+		back->globals = front->globals;
+	}
+	else
+	{
+		if (!back->globals || back->globals.use_count() > 1)
+			back->globals = ofPtr<vector<ofMatrix4x4> >(new vector<ofMatrix4x4>());
+
+		*back->globals = globals;
+	}
+
+	back->samples.resize(m_scene.size());
+
+	auto update = [&](size_t i) -> bool
+	{
+		// superseded, the rest of the frame is never shown
+		if (async && async->isStale(request)) return false;
+
+		IGeom *o = m_leaves[i];
+
+		ofPtr<SampleData> &slot = back->samples[o->m_node];
+		ofPtr<SampleData> shown = front ? front->samples[o->m_node] : ofPtr<SampleData>();
+
+		// leaves setTime doesn't evaluate keep what the last frame showed
+		const bool active = m_subscribed.empty() || m_subscribed[o->m_node];
+		if (!active || !o->m_loaded || !o->isAnimated())
+		{
+			slot = shown;
+			return false;
+		}
+
+		index_t index = o->getSampleIndex(time);
+
+		if (shown && shown->index == index)
+		{
+			slot = shown;
+			return false;
+		}
+
+		// still there from an older frame
+		if (slot && slot->index == index) return true;
+
+		ofPtr<SampleData> data;
+		if (m_prefetcher) data = m_prefetcher->take(i, index);
+
+		if (!data)
+		{
+			// never decode into a buffer another frame still shows
+			if (slot.use_count() > 1) slot.reset();
+
+			std::unique_lock<std::recursive_mutex> lock(getHDF5Mutex(), std::defer_lock);
+			if (m_hdf5) lock.lock();
+
+			data = o->readSample(index, slot);
+		}
+
+		slot = data;
+		return true;
+	};
+
+	if (m_pool && !m_hdf5)
+	{
+		std::atomic<size_t> num_leaves_updated(0);
+
+		m_pool->parallelFor(0, m_leaves.size(), [&](size_t i)
+		{
+			if (update(i))
+				num_leaves_updated++;
+		});
+
+		m_num_updated += num_leaves_updated;
+	}
+	else
+	{
+		for (int i = 0; i < m_leaves.size(); i++)
+		{
+			if (update(i))
+				m_num_updated++;
+		}
+	}
+
+	// the back buffer is only half done, it's picked up again by the next frame
+	if (async && async->isStale(request))
+	{
+		m_snapshot_stale = true;
+		return false;
+	}
+
+	m_snapshot_stale = false;
+	std::atomic_store(&m_front, ofPtr<const Snapshot>(back));
+
+	return true;
+}
+
+void ofxAlembic::Reader::setParallel(bool enable, size_t num_threads)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_time_mutex);
+
+	if (enable && m_pool && num_threads != 0 && m_pool->getNumThreads() == num_threads)
+		return;
+
+	// the prefetch worker may be decoding with the old pool
+	bool prefetch = m_prefetcher != NULL;
+	m_prefetcher.reset();
+
+	m_pool.reset();
+	if (enable)
+		m_pool = ofPtr<ThreadPool>(new ThreadPool(num_threads));
+
+	updateThreadPool();
+
+	if (prefetch)
+		resetPrefetcher();
+}
+
+bool ofxAlembic::Reader::load(IGeom* o)
+{
+	if (o->m_loaded) return false;
+
+	std::unique_lock<std::recursive_mutex> lock(getHDF5Mutex(), std::defer_lock);
+	if (m_hdf5) lock.lock();
+
+	o->load();
+
+	// catch up with the playhead, constant objects return right away
+	Imath::M44f xform;
+	xform.makeIdentity();
+	o->updateWithTimeInternal(current_time, xform);
+
+	return true;
+}
+
+size_t ofxAlembic::Reader::preload(const string& pattern)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_time_mutex);
+
+	const bool fullname = pattern.find('/') != string::npos;
+
+	vector<IGeom*> targets;
+	for (int i = 0; i < m_leaves.size(); i++)
+	{
+		IGeom *o = m_leaves[i];
+		if (o->m_loaded) continue;
+
+		if (matchPattern(pattern, fullname ? o->getFullName() : o->getName()))
+			targets.push_back(o);
+	}
+
+	std::atomic<size_t> num_loaded(0);
+
+	if (m_pool && !m_hdf5)
+	{
+		m_pool->parallelFor(0, targets.size(), [&](size_t i)
+		{
+			if (load(targets[i]))
+				num_loaded++;
+		});
+	}
+	else
+	{
+		for (int i = 0; i < targets.size(); i++)
+		{
+			if (load(targets[i]))
+				num_loaded++;
+		}
+	}
+
+	return num_loaded;
+}
+
+size_t ofxAlembic::Reader::getNumLoadedObjects() const
+{
+	size_t num = 0;
+	for (int i = 0; i < m_leaves.size(); i++)
+	{
+		if (m_leaves[i]->m_loaded)
+			num++;
+	}
+	return num;
+}
+
+#pragma mark - evaluate
+
+size_t ofxAlembic::Reader::getEvaluateSize(Handle handle)
+{
+	if (handle >= object_arr.size()) return 0;
+
+	// evaluating reads on the side, it doesn't subscribe the object or set its time
+	IGeom *o = object_arr[handle];
+	if (m_snapshot_buffers == 0) load(o);
+
+	if (o->isTypeOf(POLYMESH))
+		return ((IPolyMesh*)o)->getNumEvaluatedVertices();
+	if (o->isTypeOf(POINTS))
+		return ((IPoints*)o)->points.points.size();
+
+	return 0;
+}
+
+bool ofxAlembic::Reader::evaluate(Handle handle, const View<double>& times, glm::vec3* positions, glm::vec3* normals)
+{
+	if (handle >= object_arr.size()) return false;
+
+	IGeom *o = object_arr[handle];
+	if (m_snapshot_buffers == 0) load(o);
+	if (!o->m_loaded) return false;
+
+	// HDF5 reads one sample at a time anyway
+	std::unique_lock<std::recursive_mutex> lock(getHDF5Mutex(), std::defer_lock);
+	if (m_hdf5) lock.lock();
+
+	ThreadPool *pool = m_hdf5 ? NULL : m_pool.get();
+
+	if (o->isTypeOf(POLYMESH))
+		return ((IPolyMesh*)o)->evaluate(times, positions, normals, pool);
+	if (o->isTypeOf(POINTS))
+		return ((IPoints*)o)->evaluate(times, positions, pool);
+
+	ofLogError("ofxAlembic") << "evaluate positions of a " << o->getTypeName() << ": " << o->getName();
+	return false;
+}
+
+bool ofxAlembic::Reader::evaluate(Handle handle, const View<double>& times, ofMatrix4x4* matrices)
+{
+	if (handle >= object_arr.size()) return false;
+
+	IGeom *o = object_arr[handle];
+
+	std::unique_lock<std::recursive_mutex> lock(getHDF5Mutex(), std::defer_lock);
+	if (m_hdf5) lock.lock();
+
+	for (size_t k = 0; k < times.size(); k++)
+		matrices[k] = m_scene.evaluate(o->m_node, times[k]);
+
+	return true;
+}
+
+#pragma mark - subscriptions
+
+size_t ofxAlembic::Reader::subscribe(const string& pattern)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_time_mutex);
+
+	m_subscribed_patterns.push_back(pattern);
+	return applySubscriptions();
+}
+
+size_t ofxAlembic::Reader::subscribe(const vector<string>& patterns)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_time_mutex);
+
+	m_subscribed_patterns.insert(m_subscribed_patterns.end(), patterns.begin(), patterns.end());
+	return applySubscriptions();
+}
+
+size_t ofxAlembic::Reader::subscribe(Type type)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_time_mutex);
+
+	m_subscribed_types.push_back(type);
+	return applySubscriptions();
+}
+
+void ofxAlembic::Reader::unsubscribeAll()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_time_mutex);
+
+	m_subscribed_patterns.clear();
+	m_subscribed_types.clear();
+	m_read.clear();
+	applySubscriptions();
+}
+
+bool ofxAlembic::Reader::isSubscribed(Handle handle) const
+{
+	if (handle >= object_arr.size()) return false;
+	return m_subscribed.empty() || m_subscribed[object_arr[handle]->m_node];
+}
+
+bool ofxAlembic::Reader::matchSubscription(IGeom* o) const
+{
+	for (int i = 0; i < m_subscribed_types.size(); i++)
+	{
+		if (o->isTypeOf(m_subscribed_types[i]))
+			return true;
+	}
+
+	for (int i = 0; i < m_subscribed_patterns.size(); i++)
+	{
+		const string &pattern = m_subscribed_patterns[i];
+		const bool fullname = pattern.find('/') != string::npos;
+
+		if (matchPattern(pattern, fullname ? o->getFullName() : o->getName()))
+			return true;
+	}
+
+	return false;
 }
 
-void ofxAlembic::IXform::updateWithTimeInternal(double time, Imath::M44f& xform)
+void ofxAlembic::Reader::updateSubscriptions()
 {
-	if (!m_xform.getSchema().isConstant()
-		&& ofInRange(time, m_minTime, m_maxTime))
+	m_subscribed.clear();
+
+	if (hasSubscriptions())
 	{
-		this->xform.set(m_xform.getSchema(), time);
+		// node 0 is the archive top
+		m_subscribed.resize(m_scene.size(), false);
+		for (int i = 1; i < m_scene.size(); i++)
+		{
+			IGeom *o = m_scene.getGeom(i);
+			if ((i < m_read.size() && m_read[i]) || (!o->isTypeOf(UNKHOWN) && matchSubscription(o)))
+				m_subscribed[i] = true;
+		}
 	}
-	
-	xform = this->xform.mat * xform;
-}
 
-#pragma mark - IPoints
+	updateActive();
+}
 
-ofxAlembic::IPoints::IPoints(Alembic::AbcGeom::IPoints object) : ofxAlembic::IGeom(object), m_points(object)
+void ofxAlembic::Reader::updateActive()
 {
-	update_timestamp(m_points);
-	type = POINTS;
-	
-	if (m_points.getSchema().isConstant())
+	m_active.clear();
+	m_num_skipped = 0;
+	m_active_stale = false;
+
+	for (int i = 0; i < m_leaves.size(); i++)
 	{
-		points.set(m_points.getSchema(), m_minTime);
+		if (m_subscribed.empty() || m_subscribed[m_leaves[i]->m_node])
+			m_active.push_back(i);
+		else if (m_leaves[i]->isAnimated())
+			m_num_skipped++;
 	}
+
+	m_scene.setActive(m_subscribed);
+	m_num_skipped += m_scene.getNumSkipped();
 }
 
-void ofxAlembic::IPoints::updateWithTimeInternal(double time, Imath::M44f& xform)
+size_t ofxAlembic::Reader::applySubscriptions()
 {
-	if (m_points.getSchema().isConstant()) return;
-	points.set(m_points.getSchema(), time);
-}
+	std::lock_guard<std::recursive_mutex> lock(m_time_mutex);
 
-#pragma mark - ICurves
+	if (!m_root) return 0;
 
-ofxAlembic::ICurves::ICurves(Alembic::AbcGeom::ICurves object) : ofxAlembic::IGeom(object), m_curves(object)
-{
-	update_timestamp(m_curves);
-	type = CURVES;
-	
-	if (m_curves.getSchema().isConstant())
+	updateSubscriptions();
+
+	// eager archives load what they left out at open
+	if (!m_lazy)
 	{
-		curves.set(m_curves.getSchema(), m_minTime);
+		for (int i = 0; i < m_active.size(); i++)
+			load(m_leaves[m_active[i]]);
 	}
-}
 
-void ofxAlembic::ICurves::updateWithTimeInternal(double time, Imath::M44f& xform)
-{
-	if (m_curves.getSchema().isConstant()) return;
-	curves.set(m_curves.getSchema(), time);
-}
+	// the read-ahead follows the subscribed set
+	resetPrefetcher();
 
-#pragma mark - IPolyMesh
+	setTime(current_time);
+
+	return hasSubscriptions() ? std::count(m_subscribed.begin(), m_subscribed.end(), true) : object_arr.size();
+}
 
-ofxAlembic::IPolyMesh::IPolyMesh(Alembic::AbcGeom::IPolyMesh object) : ofxAlembic::IGeom(object), m_polyMesh(object)
+void ofxAlembic::Reader::updateThreadPool()
 {
-	update_timestamp(m_polyMesh);
-	type = POLYMESH;
-	
-	if (m_polyMesh.getSchema().isConstant())
+	// large meshes also split their own work over the pool
+	for (int i = 0; i < m_leaves.size(); i++)
 	{
-		polymesh.set(m_polyMesh.getSchema(), m_minTime);
+		if (m_leaves[i]->isTypeOf(POLYMESH))
+			((IPolyMesh*)m_leaves[i])->setThreadPool(m_pool.get());
 	}
 }
 
-void ofxAlembic::IPolyMesh::updateWithTimeInternal(double time, Imath::M44f& xform)
+void ofxAlembic::Reader::setPrefetch(bool enable, size_t num_frames, size_t max_bytes)
 {
-	if (m_polyMesh.getSchema().isConstant()) return;
-	polymesh.set(m_polyMesh.getSchema(), time);
+	std::lock_guard<std::recursive_mutex> lock(m_time_mutex);
+
+	m_prefetch_frames = enable ? num_frames : 0;
+	m_prefetch_bytes = max_bytes;
+
+	resetPrefetcher();
 }
 
-#pragma mark - ICamera
+void ofxAlembic::Reader::resetPrefetcher()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_time_mutex);
 
-ofxAlembic::ICamera::ICamera(Alembic::AbcGeom::ICamera object) : ofxAlembic::IGeom(object), m_camera(object)
+	m_prefetcher.reset();
+
+	if (!m_root || m_prefetch_frames == 0) return;
+
+	// leaves setTime doesn't evaluate keep their slot but get no ring
+	vector<IGeom*> leaves(m_leaves.size(), NULL);
+	for (int i = 0; i < m_active.size(); i++)
+		leaves[m_active[i]] = m_leaves[m_active[i]];
+
+	m_prefetcher = ofPtr<Prefetcher>(new Prefetcher(leaves, m_minTime, m_maxTime, m_hdf5, m_prefetch_frames, m_prefetch_bytes));
+}
+
+size_t ofxAlembic::Reader::getPrefetchHits() const
 {
-	update_timestamp(m_camera);
-	type = CAMERA;
-	
-	if (m_camera.getSchema().isConstant())
-	{
-		camera.set(m_camera.getSchema(), m_minTime);
-	}
+	return m_prefetcher ? m_prefetcher->getHits() : 0;
 }
 
-void ofxAlembic::ICamera::updateWithTimeInternal(double time, Imath::M44f& xform)
+size_t ofxAlembic::Reader::getPrefetchMisses() const
 {
-	if (m_camera.getSchema().isConstant()) return;
-	camera.set(m_camera.getSchema(), time);
+	return m_prefetcher ? m_prefetcher->getMisses() : 0;
 }
 
-#pragma mark - Reader
+size_t ofxAlembic::Reader::getPrefetchMemoryUsage() const
+{
+	return m_prefetcher ? m_prefetcher->getMemoryUsage() : 0;
+}
 
-bool ofxAlembic::Reader::open(const string& path)
+void ofxAlembic::Reader::setFrameCache(bool enable, size_t max_bytes)
 {
-	ofxAlembic::init();
-	
-	if (!ofFile::doesFileExist(path))
+	std::lock_guard<std::recursive_mutex> lock(m_time_mutex);
+
+	if (!enable)
 	{
-		ofLogError("ofxAlembic") << "file not found: " << path;
-		return false;
+		m_cache.reset();
+		return;
 	}
 
-	m_archive = IArchive(Alembic::AbcCoreHDF5::ReadArchive(), ofToDataPath(path),
-                         Alembic::Abc::ErrorHandler::kQuietNoopPolicy);
-    if (!m_archive.valid()) {
-        m_archive = IArchive(Alembic::AbcCoreOgawa::ReadArchive(), ofToDataPath(path),
-                             Alembic::Abc::ErrorHandler::kNoisyNoopPolicy);
-        if (!m_archive.valid()) return false;
-    }
+	if (m_cache)
+		m_cache->setMaxBytes(max_bytes);
+	else
+		m_cache = ofPtr<FrameCache>(new FrameCache(max_bytes));
+}
 
-	m_root = ofPtr<IGeom>(new IGeom(m_archive.getTop()));
+void ofxAlembic::Reader::setBakedXforms(bool enable)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_time_mutex);
 
-	{
-		object_arr.clear();
-		object_name_arr.clear();
-		object_fullname_arr.clear();
-		object_name_map.clear();
+	m_baked_xforms = enable;
+	if (!m_root) return;
+
+	// the tables hold the same matrices the schema would decode, no need to re-evaluate
+	if (enable)
+		m_scene.bake(m_hdf5, m_pool.get());
+	else
+		m_scene.unbake();
+}
 
-		ofxAlembic::IGeom::visit_geoms(m_root, object_name_map, object_fullname_map);
+void ofxAlembic::Reader::setIndexedMesh(bool indexed)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_time_mutex);
 
-		{
-			map<string, IGeom*>::iterator it = object_name_map.begin();
-			while (it != object_name_map.end())
-			{
-				object_arr.push_back(it->second);
-				object_name_arr.push_back(it->first);
-				it++;
-			}
-		}
+	m_indexed_mesh = indexed;
+	
+	if (!m_root) return;
+	
+	// decoded buffers are in the old layout
+	m_prefetcher.reset();
+	if (m_cache)
+		m_cache->clear();
+	
+	{
+		std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
 		
+		for (int i = 0; i < m_leaves.size(); i++)
 		{
-			map<string, IGeom*>::iterator it = object_fullname_map.begin();
-			while (it != object_fullname_map.end())
-			{
-				object_fullname_arr.push_back(it->first);
-				it++;
-			}
+			if (m_leaves[i]->isTypeOf(POLYMESH))
+				((IPolyMesh*)m_leaves[i])->setIndexed(indexed);
 		}
 	}
-
-	m_minTime = m_root->m_minTime;
-	m_maxTime = m_root->m_maxTime;
-
-	return true;
+	
+	resetPrefetcher();
+	
+	setTime(current_time);
 }
 
-void ofxAlembic::Reader::close()
+size_t ofxAlembic::Reader::getNumMeshVertices() const
 {
-	object_arr.clear();
-	object_name_arr.clear();
-	object_fullname_arr.clear();
-	object_name_map.clear();
-
-	if (m_root)
-		m_root.reset();
-
-	if (m_archive.valid())
-		m_archive.reset();
+	size_t num = 0;
+	for (int i = 0; i < m_leaves.size(); i++)
+	{
+		if (m_leaves[i]->isTypeOf(POLYMESH))
+			num += ((IPolyMesh*)m_leaves[i])->polymesh.mesh.getNumVertices();
+	}
+	return num;
 }
 
-void ofxAlembic::Reader::draw()
+size_t ofxAlembic::Reader::getNumMeshIndices() const
 {
-	if (!m_root) return;
-
-	m_root->draw();
+	size_t num = 0;
+	for (int i = 0; i < m_leaves.size(); i++)
+	{
+		if (m_leaves[i]->isTypeOf(POLYMESH))
+			num += ((IPolyMesh*)m_leaves[i])->polymesh.mesh.getNumIndices();
+	}
+	return num;
 }
 
-void ofxAlembic::Reader::debugDraw()
+size_t ofxAlembic::Reader::getFrameCacheMemoryUsage() const
 {
-	if (!m_root) return;
-	
-	m_root->debugDraw();
+	return m_cache ? m_cache->getMemoryUsage() : 0;
 }
 
-void ofxAlembic::Reader::setTime(double time)
+float ofxAlembic::Reader::getFrameCacheHitRatio() const
 {
-	if (!m_root) return;
-
-	Imath::M44f m;
-	m.makeIdentity();
-	m_root->updateWithTime(time, m);
-
-	current_time = time;
+	return m_cache ? m_cache->getHitRatio() : 0;
 }
 
 void ofxAlembic::Reader::dumpNames()
@@ -214,7 +1378,7 @@ void ofxAlembic::Reader::dumpNames()
 
 	for (int i = 0; i < names.size(); i++)
 	{
-		cout << i << ": " << object_name_map[names[i]]->getTypeName() << " '" << names[i] << "'" << endl;
+		cout << i << ": " << object_arr[i]->getTypeName() << " '" << names[i] << "'" << endl;
 	}
 }
 
@@ -224,49 +1388,138 @@ void ofxAlembic::Reader::dumpFullnames()
 	
 	for (int i = 0; i < names.size(); i++)
 	{
-		cout << i << ": " << object_fullname_map[names[i]]->getTypeName() << " '" << names[i] << "'" << endl;
+		cout << i << ": " << object_arr[resolve(names[i])]->getTypeName() << " '" << names[i] << "'" << endl;
+	}
+}
+
+IGeom* ofxAlembic::Reader::get(size_t idx)
+{
+	if (idx >= object_arr.size()) return NULL;
+
+	IGeom *o = object_arr[idx];
+
+	// the thread calling setTime owns the objects in snapshot mode
+	if (m_snapshot_buffers > 0) return o;
+
+	// reading an object subscribes it, it follows setTime from the next frame on
+	if (!m_subscribed.empty() && !m_subscribed[o->m_node])
+	{
+		m_read.resize(m_scene.size(), false);
+		m_read[o->m_node] = true;
+		m_subscribed[o->m_node] = true;
+		m_active_stale = true;
+
+		// it may have been skipped since it was loaded
+		if (o->m_loaded)
+		{
+			std::unique_lock<std::recursive_mutex> lock(getHDF5Mutex(), std::defer_lock);
+			if (m_hdf5) lock.lock();
+
+			Imath::M44f xform;
+			xform.makeIdentity();
+			o->updateWithTimeInternal(current_time, xform);
+		}
+	}
+
+	if (!o->m_loaded) load(o);
+
+	return o;
+}
+
+Handle ofxAlembic::Reader::resolve(const string& path) const
+{
+	// short names never contain a separator
+	if (!path.empty() && path[0] == '/')
+	{
+		std::unordered_map<string, Handle>::const_iterator it = object_fullname_map.find(path);
+		return it != object_fullname_map.end() ? it->second : INVALID_HANDLE;
+	}
+
+	// the multimap doesn't keep insertion order of equal keys, take the lowest handle
+	typedef std::unordered_multimap<string, Handle>::const_iterator Iter;
+	std::pair<Iter, Iter> range = object_name_map.equal_range(path);
+
+	Handle h = INVALID_HANDLE;
+	for (Iter it = range.first; it != range.second; it++)
+		h = std::min(h, it->second);
+
+	return h;
+}
+
+size_t ofxAlembic::Reader::resolveAll(const string& path, vector<Handle>& handles) const
+{
+	handles.clear();
+
+	if (!path.empty() && path[0] == '/')
+	{
+		Handle h = resolve(path);
+		if (h != INVALID_HANDLE) handles.push_back(h);
+		return handles.size();
 	}
+
+	typedef std::unordered_multimap<string, Handle>::const_iterator Iter;
+	std::pair<Iter, Iter> range = object_name_map.equal_range(path);
+	for (Iter it = range.first; it != range.second; it++)
+		handles.push_back(it->second);
+
+	std::sort(handles.begin(), handles.end());
+	return handles.size();
 }
 
 bool ofxAlembic::Reader::get(const string& path, ofMatrix4x4& matrix)
 {
-	IGeom *o = get(path);
-	if (o == NULL) return false;
-	return o->get(matrix);
+	return get(resolve(path), matrix);
 }
 
 bool ofxAlembic::Reader::get(const string& path, ofMesh& mesh)
 {
-	IGeom *o = get(path);
-	if (o == NULL) return false;
-	return o->get(mesh);
+	return get(resolve(path), mesh);
 }
 
 bool ofxAlembic::Reader::get(const string& path, vector<ofPolyline>& curves)
 {
-	IGeom *o = get(path);
-	if (o == NULL) return false;
-	return o->get(curves);
+	return get(resolve(path), curves);
 }
 
 bool ofxAlembic::Reader::get(const string& path, vector<glm::vec3>& points)
 {
 	IGeom *o = get(path);
 	if (o == NULL) return false;
+
+	if (m_snapshot_buffers > 0)
+	{
+		ofPtr<const Snapshot> snapshot = getSnapshot();
+		const Points *p = snapshot ? snapshot->getPoints(o) : NULL;
+		if (p == NULL) return false;
+
+		points.resize(p->points.size());
+		for (int i = 0; i < p->points.size(); i++)
+			points[i] = p->points[i].pos;
+		return true;
+	}
+
 	return o->get(points);
 }
 
 bool ofxAlembic::Reader::get(const string& path, ofCamera &camera)
 {
-	IGeom *o = get(path);
-	if (o == NULL) return false;
-	return o->get(camera);
+	return get(resolve(path), camera);
 }
 
 bool ofxAlembic::Reader::get(size_t idx, ofMatrix4x4& matrix)
 {
 	IGeom *o = get(idx);
 	if (o == NULL) return false;
+
+	if (m_snapshot_buffers > 0)
+	{
+		ofPtr<const Snapshot> snapshot = getSnapshot();
+		if (!snapshot || !o->isTypeOf(XFORM)) return false;
+
+		matrix = snapshot->getGlobalTransform(o);
+		return true;
+	}
+
 	return o->get(matrix);
 }
 
@@ -274,6 +1527,17 @@ bool ofxAlembic::Reader::get(size_t idx, ofMesh& mesh)
 {
 	IGeom *o = get(idx);
 	if (o == NULL) return false;
+
+	if (m_snapshot_buffers > 0)
+	{
+		ofPtr<const Snapshot> snapshot = getSnapshot();
+		const PolyMesh *p = snapshot ? snapshot->getPolyMesh(o) : NULL;
+		if (p == NULL) return false;
+
+		mesh = p->mesh;
+		return true;
+	}
+
 	return o->get(mesh);
 }
 
@@ -281,6 +1545,17 @@ bool ofxAlembic::Reader::get(size_t idx, vector<ofPolyline>& curves)
 {
 	IGeom *o = get(idx);
 	if (o == NULL) return false;
+
+	if (m_snapshot_buffers > 0)
+	{
+		ofPtr<const Snapshot> snapshot = getSnapshot();
+		const Curves *c = snapshot ? snapshot->getCurves(o) : NULL;
+		if (c == NULL) return false;
+
+		curves = c->curves;
+		return true;
+	}
+
 	return o->get(curves);
 }
 
@@ -288,6 +1563,19 @@ bool ofxAlembic::Reader::get(size_t idx, vector<ofVec3f>& points)
 {
 	IGeom *o = get(idx);
 	if (o == NULL) return false;
+
+	if (m_snapshot_buffers > 0)
+	{
+		ofPtr<const Snapshot> snapshot = getSnapshot();
+		const Points *p = snapshot ? snapshot->getPoints(o) : NULL;
+		if (p == NULL) return false;
+
+		points.resize(p->points.size());
+		for (int i = 0; i < p->points.size(); i++)
+			points[i] = p->points[i].pos;
+		return true;
+	}
+
 	return o->get(points);
 }
 
@@ -295,18 +1583,31 @@ bool ofxAlembic::Reader::get(size_t idx, ofCamera &camera)
 {
 	IGeom *o = get(idx);
 	if (o == NULL) return false;
+
+	if (m_snapshot_buffers > 0)
+	{
+		ofPtr<const Snapshot> snapshot = getSnapshot();
+		const Camera *c = snapshot ? snapshot->getCamera(o) : NULL;
+		if (c == NULL) return false;
+
+		c->updateParams(camera, snapshot->getGlobalTransform(o));
+		return true;
+	}
+
 	return o->get(camera);
 }
 
 #pragma mark - IGeom
 
-IGeom::IGeom() : m_minTime(std::numeric_limits<float>::infinity()), m_maxTime(0), type(UNKHOWN) {}
+IGeom::IGeom() : type(UNKHOWN), m_scene(NULL), m_node(0), m_parent(NULL), m_opened(true), m_loaded(true), m_snapshots(NULL), m_minTime(std::numeric_limits<float>::infinity()), m_maxTime(0), m_sampleIndex(-1), m_constant(true), m_numSamples(0) {}
 
-IGeom::IGeom(Alembic::AbcGeom::IObject object) : m_object(object), m_minTime(std::numeric_limits<float>::infinity()), m_maxTime(0), type(UNKHOWN)
+IGeom::IGeom(Alembic::AbcGeom::IObject object) : type(UNKHOWN), m_scene(NULL), m_node(0), m_parent(NULL), m_opened(true), m_object(object), m_loaded(true), m_snapshots(NULL), m_minTime(std::numeric_limits<float>::infinity()), m_maxTime(0), m_sampleIndex(-1), m_constant(true), m_numSamples(0)
 {
 	setupWithObject(m_object);
 }
 
+IGeom::IGeom(const ArchiveIndex::Entry& entry, IGeom* parent) : type(UNKHOWN), m_scene(NULL), m_node(0), m_parent(parent), m_name(entry.fullname.substr(entry.fullname.rfind('/') + 1)), m_fullname(entry.fullname), m_opened(false), m_loaded(true), m_snapshots(NULL), m_minTime(entry.min_time), m_maxTime(entry.max_time), m_sampleIndex(-1), m_constant(entry.constant), m_numSamples(entry.num_samples) {}
+
 IGeom::~IGeom()
 {
 	m_children.clear();
@@ -404,51 +1705,101 @@ void IGeom::setupWithObject(IObject object)
 void IGeom::draw()
 {
 	ofPushMatrix();
-	ofMultMatrix(transform);
+	ofMultMatrix(getGlobalTransform());
 	drawInternal();
 	ofPopMatrix();
 
 	for (int i = 0; i < m_children.size(); i++)
-	{
-		ofPtr<IGeom> c = m_children[i];
-		c->draw();
-	}
+		m_children[i]->draw();
 }
 
 void IGeom::debugDraw()
 {
 	ofPushMatrix();
-	ofMultMatrix(transform);
+	ofMultMatrix(getGlobalTransform());
 	debugDrawInternal();
 	ofPopMatrix();
 	
 	for (int i = 0; i < m_children.size(); i++)
-	{
-		ofPtr<IGeom> c = m_children[i];
-		c->debugDraw();
-	}
+		m_children[i]->debugDraw();
+}
+
+const ofMatrix4x4& IGeom::getGlobalTransform() const
+{
+	static const ofMatrix4x4 identity;
+	return m_scene ? m_scene->getGlobalTransform(m_node) : identity;
+}
+
+bool IGeom::check_live() const
+{
+	if (!m_snapshots) return true;
+
+	ofLogError("ofxAlembic::IGeom") << "'" << getName() << "' isn't updated in snapshot mode, read it through Reader::getSnapshot";
+	return false;
+}
+
+const Points* IGeom::current(const Points& live, ofPtr<const Snapshot>& hold) const
+{
+	if (!m_snapshots) return &live;
+
+	hold = m_snapshots->getSnapshot();
+	return hold ? hold->getPoints(this) : NULL;
+}
+
+const Curves* IGeom::current(const Curves& live, ofPtr<const Snapshot>& hold) const
+{
+	if (!m_snapshots) return &live;
+
+	hold = m_snapshots->getSnapshot();
+	return hold ? hold->getCurves(this) : NULL;
+}
+
+const PolyMesh* IGeom::current(const PolyMesh& live, ofPtr<const Snapshot>& hold) const
+{
+	if (!m_snapshots) return &live;
+
+	hold = m_snapshots->getSnapshot();
+	return hold ? hold->getPolyMesh(this) : NULL;
+}
+
+const Camera* IGeom::current(const Camera& live, ofPtr<const Snapshot>& hold) const
+{
+	if (!m_snapshots) return &live;
+
+	hold = m_snapshots->getSnapshot();
+	return hold ? hold->getCamera(this) : NULL;
+}
+
+const ofMatrix4x4& IGeom::current_transform(const ofPtr<const Snapshot>& hold) const
+{
+	return hold ? hold->getGlobalTransform(this) : getGlobalTransform();
 }
 
 string IGeom::getName() const
 {
-	return m_object.getName();
+	return m_fullname.empty() ? m_object.getName() : m_name;
 }
 
 string IGeom::getFullName() const
 {
-	return m_object.getFullName();
+	return m_fullname.empty() ? m_object.getFullName() : m_fullname;
 }
 
-void IGeom::updateWithTime(double time, Imath::M44f& xform)
+const IObject& IGeom::object()
 {
-	updateWithTimeInternal(time, xform);
-	transform = toOf(xform);
-	
-	for (int i = 0; i < m_children.size(); i++)
+	if (!m_opened)
 	{
-		Imath::M44f m = xform;
-		m_children[i]->updateWithTime(time, m);
+		// loads and xform reads may run on the pool, parents are opened along the way
+		std::lock_guard<std::recursive_mutex> lock(open_mutex());
+
+		if (!m_opened)
+		{
+			m_object = IObject(m_parent->object(), m_name);
+			m_opened = true;
+		}
 	}
+
+	return m_object;
 }
 
 template <typename T>
@@ -464,18 +1815,58 @@ void ofxAlembic::IGeom::update_timestamp(T& object)
 			m_maxTime = iTsmp->getSampleTime(numSamps - 1);
 		}
 	}
+	
+	m_constant = object.getSchema().isConstant();
+	m_numSamples = object.getSchema().getNumSamples();
+}
+
+template <typename T>
+bool ofxAlembic::IGeom::update_sample_index(T& schema, double time)
+{
+	index_t index = get_sample_index(schema, time);
+	
+	if (index == m_sampleIndex) return false;
+	
+	m_sampleIndex = index;
+	return true;
+}
+
+template <typename T>
+index_t ofxAlembic::IGeom::get_sample_index(T& schema, double time)
+{
+	ISampleSelector ss(time, ISampleSelector::kNearIndex);
+	return ss.getIndex(schema.getTimeSampling(), schema.getNumSamples());
 }
 
-void ofxAlembic::IGeom::visit_geoms(ofPtr<IGeom> &obj, map<string, IGeom*> &object_name_map, map<string, IGeom*> &object_fullname_map)
+template <typename T>
+TypedSampleData<T>* ofxAlembic::IGeom::sample_buffer(ofPtr<SampleData>& data)
 {
-	for (int i = 0; i < obj->m_children.size(); i++)
-		visit_geoms(obj->m_children[i], object_name_map, object_fullname_map);
+	TypedSampleData<T> *typed = dynamic_cast<TypedSampleData<T>*>(data.get());
+	if (typed == NULL)
+	{
+		typed = new TypedSampleData<T>();
+		data = ofPtr<SampleData>(typed);
+	}
 	
-	if (obj->isTypeOf(UNKHOWN)) return;
+	return typed;
+}
+
+template <typename T, typename Schema>
+ofPtr<SampleData> ofxAlembic::IGeom::read_sample(Schema& schema, index_t index, ofPtr<SampleData> data)
+{
+	TypedSampleData<T> *typed = sample_buffer<T>(data);
+	typed->value.set(schema, ISampleSelector(index));
+	typed->index = index;
 	
-//	assert(object_name_map.find(obj->getName()) == object_name_map.end());
-	object_name_map[obj->getName()] = obj.get();
+	return data;
+}
+
+template <typename T>
+void ofxAlembic::IGeom::swap_sample(T& value, ofPtr<SampleData>& data)
+{
+	TypedSampleData<T> *typed = dynamic_cast<TypedSampleData<T>*>(data.get());
+	if (typed == NULL) return;
 	
-//	assert(object_fullname_map.find(obj->getFullName()) == object_fullname_map.end());
-	object_fullname_map[obj->getFullName()] = obj.get();
+	value.swap(typed->value);
+	std::swap(m_sampleIndex, typed->index);
 }
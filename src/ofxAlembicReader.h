@@ -4,15 +4,29 @@
 #include <Alembic/AbcCoreHDF5/All.h>
 #include <Alembic/AbcCoreOgawa/All.h>
 
+#include <unordered_map>
+#include <future>
+
 #include "ofMain.h"
 
 #include "ofxAlembicUtil.h"
 #include "ofxAlembicType.h"
+#include "ofxAlembicThreadPool.h"
+#include "ofxAlembicScene.h"
+#include "ofxAlembicIndex.h"
 
 namespace ofxAlembic
 {
 class Reader;
 class IGeom;
+class Prefetcher;
+class FrameCache;
+class Snapshot;
+class AsyncUpdater;
+class SampleData;
+
+template <typename T>
+class TypedSampleData;
 
 class IXform;
 class IPoints;
@@ -20,6 +34,10 @@ class ICurves;
 class IPolyMesh;
 class ICamera;
 
+// stable index of an object for the lifetime of an opened archive, same as get(size_t)
+typedef size_t Handle;
+static const Handle INVALID_HANDLE = (Handle)-1;
+
 template <typename T>
 inline ofxAlembic::Type type2enum() { return ofxAlembic::UNKHOWN; }
 
@@ -34,16 +52,79 @@ inline ofxAlembic::Type type2enum<ofxAlembic::Curves>() { return ofxAlembic::CUR
 
 template <>
 inline ofxAlembic::Type type2enum<ofxAlembic::PolyMesh>() { return ofxAlembic::POLYMESH; }
+
+template <>
+inline ofxAlembic::Type type2enum<ofxAlembic::Camera>() { return ofxAlembic::CAMERA; }
+
+template <>
+inline ofxAlembic::Type type2enum<ofxAlembic::IXform>() { return ofxAlembic::XFORM; }
+
+template <>
+inline ofxAlembic::Type type2enum<ofxAlembic::IPoints>() { return ofxAlembic::POINTS; }
+
+template <>
+inline ofxAlembic::Type type2enum<ofxAlembic::ICurves>() { return ofxAlembic::CURVES; }
+
+template <>
+inline ofxAlembic::Type type2enum<ofxAlembic::IPolyMesh>() { return ofxAlembic::POLYMESH; }
+
+template <>
+inline ofxAlembic::Type type2enum<ofxAlembic::ICamera>() { return ofxAlembic::CAMERA; }
 }
 
 class ofxAlembic::Reader
 {
+	friend class AsyncUpdater;
+
 public:
 
-	~Reader() {}
+	Reader() : m_hdf5(false), m_num_streams(1), m_num_updated(0), m_prefetch_frames(0), m_prefetch_bytes(0), m_indexed_mesh(false), m_baked_xforms(false), m_lazy(false), m_sidecar_index(false), m_index_hit(false), m_active_stale(false), m_num_skipped(0), m_snapshot_buffers(0), m_snapshot_stale(false), current_time(0) {}
+	~Reader() { m_async.reset(); }
 
-	bool open(const string& path);
+	// num_streams > 1 opens Ogawa archives with that many file streams so
+	// worker threads can read samples concurrently
+	bool open(const string& path, size_t num_streams = 1);
 	void close();
+
+	// lazy archives only build the hierarchy in open, leaf geometry is decoded on
+	// first access through get/find and only loaded leaves are evaluated by setTime
+	void setLazy(bool lazy) { m_lazy = lazy; }
+	inline bool isLazy() const { return m_lazy; }
+
+	// loads every leaf whose full path (or name, if the pattern has no '/') matches
+	// the glob pattern, returns the number of leaves loaded by this call
+	size_t preload(const string& pattern = "*");
+	size_t getNumLoadedObjects() const;
+
+	// keep the hierarchy, time ranges, constant xforms and bounds in <file>.abcidx next to
+	// the archive, rewritten whenever the archive changes. opens with a valid index build
+	// the tree from it and only open the objects that are loaded or animated
+	void setSidecarIndex(bool enable) { m_sidecar_index = enable; }
+	inline bool isSidecarIndex() const { return m_sidecar_index; }
+
+	// NULL unless the sidecar index is enabled
+	inline const ArchiveIndex* getArchiveIndex() const { return m_index.get(); }
+	// the last open read a valid index instead of writing a new one
+	inline bool isArchiveIndexHit() const { return m_index_hit; }
+	
+	// restrict setTime to the objects the app reads. patterns are globs over full paths
+	// (or names, without '/'), the xforms above a subscribed object are evaluated with it.
+	// other leaves aren't loaded or decoded until get/find asks for them, which subscribes them
+	// until close or unsubscribeAll (their xforms follow from the next setTime).
+	// patterns and types are kept across open, without any everything is evaluated.
+	// returns the number of subscribed objects in the open archive
+	size_t subscribe(const string& pattern);
+	size_t subscribe(const vector<string>& patterns);
+	size_t subscribe(Type type);
+	void unsubscribeAll();
+
+	inline bool hasSubscriptions() const { return !m_subscribed_patterns.empty() || !m_subscribed_types.empty(); }
+
+	// true for every object without subscriptions
+	bool isSubscribed(Handle handle) const;
+
+	// animated leaves and xforms setTime leaves alone because nothing subscribed needs them
+	inline size_t getNumSkippedObjects() const { return m_num_skipped; }
 	
 	void dumpNames();
 	void dumpFullnames();
@@ -51,6 +132,73 @@ public:
 	void setTime(double time);
 	float getTime() const { return current_time; }
 
+	// setTime on an internal thread, returns right away. a newer request replaces one
+	// that is still waiting and abandons one that is being decoded, every future becomes
+	// ready with the time of the first frame published after its request.
+	// needs snapshot mode (setSnapshots(true) first), otherwise the future holds an error.
+	// read the frames through get, draw or getSnapshot
+	std::future<double> setTimeAsync(double time);
+
+	// requests replaced while waiting, and abandoned while decoding
+	size_t getNumCoalescedRequests() const;
+	size_t getNumCancelledRequests() const;
+
+	// evaluate leaf geometries on a thread pool in setTime, num_threads == 0 uses all cores
+	void setParallel(bool enable, size_t num_threads = 0);
+	inline bool isParallel() const { return m_pool != NULL; }
+
+	// decode the next num_frames samples of animated geometry on a background thread
+	void setPrefetch(bool enable, size_t num_frames = 8, size_t max_bytes = 256 * 1024 * 1024);
+	inline bool isPrefetch() const { return m_prefetch_frames > 0; }
+
+	size_t getPrefetchHits() const;
+	size_t getPrefetchMisses() const;
+	size_t getPrefetchMemoryUsage() const;
+
+	// keep decoded samples keyed by (object, sample index) so revisiting a frame is a buffer swap
+	void setFrameCache(bool enable, size_t max_bytes = 512 * 1024 * 1024);
+	inline bool isFrameCache() const { return m_cache != NULL; }
+
+	size_t getFrameCacheMemoryUsage() const;
+	float getFrameCacheHitRatio() const;
+
+	// setTime decodes into a free buffer of a ring and publishes it as the new frame, so
+	// one thread can run setTime while others read through get/draw or a held snapshot.
+	// get never loads or subscribes in this mode, open, close, subscribe and the other
+	// setters still belong to the thread calling setTime. the frame cache isn't used.
+	// the objects themselves aren't updated, see IGeom::isLive
+	void setSnapshots(bool enable, size_t num_buffers = 3);
+	inline bool isSnapshots() const { return m_snapshot_buffers > 0; }
+
+	// latest published frame, NULL before the first one. it stays valid and unchanged
+	// while held, until the archive is closed
+	ofPtr<const Snapshot> getSnapshot() const;
+
+	// read all xform samples at open, setTime then looks matrices up in a table
+	void setBakedXforms(bool enable);
+	inline bool isBakedXforms() const { return m_baked_xforms; }
+	inline size_t getBakedXformMemoryUsage() const { return m_scene.getBakedMemoryUsage(); }
+
+	// polymeshes keep P as the vertex array with an index buffer instead of a triangle soup
+	void setIndexedMesh(bool indexed);
+	inline bool isIndexedMesh() const { return m_indexed_mesh; }
+
+	// totals over all polymeshes, to compare the output modes
+	size_t getNumMeshVertices() const;
+	size_t getNumMeshIndices() const;
+
+	// number of objects that decoded a new sample in the last setTime
+	inline size_t getNumUpdatedObjects() const { return m_num_updated; }
+
+	// global matrices recomputed in the last setTime, static chains are baked at open
+	inline size_t getNumRecomputedTransforms() const { return m_scene.getNumRecomputed(); }
+
+	inline bool isHDF5() const { return m_hdf5; }
+	inline size_t getNumStreams() const { return m_num_streams; }
+
+	// flattened hierarchy, parents before children
+	inline const Scene& getScene() const { return m_scene; }
+
 	inline float getMinTime() const { return m_minTime; }
 	inline float getMaxTime() const { return m_maxTime; }
 
@@ -73,26 +221,84 @@ public:
 	bool get(size_t idx, vector<ofVec3f>& points);
 	bool get(size_t idx, ofCamera &camera);
 
-	inline IGeom* get(size_t idx) { return object_arr[idx]; }
+	IGeom* get(size_t idx);
 	
-	IGeom* get(const string& path)
-	{
-		if (object_name_map.find(path) != object_name_map.end())
-			return object_name_map[path];
-		if (object_fullname_map.find(path) != object_fullname_map.end())
-			return object_fullname_map[path];
+	IGeom* get(const string& path) { return get(resolve(path)); }
 
-		return NULL;
-	}
+	// full path ("/a/b") or short name ("b") to a handle, one hash lookup.
+	// a short name shared by several objects resolves to the first one in hierarchy order
+	Handle resolve(const string& path) const;
+
+	// all objects matching path, more than one only for duplicated short names
+	size_t resolveAll(const string& path, vector<Handle>& handles) const;
+
+	// typed handle, e.g. find<IPolyMesh>("/mesh"), NULL when missing or of another type.
+	// resolve once and read through the handle every frame without copies.
+	// in snapshot mode get(T&) copies from the latest frame, the zero copy accessors return
+	// nothing, pass the object to a held getSnapshot() instead
+	template <typename T>
+	T* find(const string& path);
+
+	template <typename T>
+	T* find(Handle handle);
+
+	// one object at several times (shutter open/close, a bake range) without setTime
+	// or touching the current frame. each sample is read once however many times land
+	// on it, polymeshes reuse their triangulation.
+	// positions (and normals when given) are written as times.size() consecutive blocks of
+	// getEvaluateSize(handle) vertices, in the layout of getMesh()/getPoints().
+	// polymeshes need constant or homogeneous topology, and non indexed normals when normals
+	// are given. points need a constant count
+	size_t getEvaluateSize(Handle handle);
+	bool evaluate(Handle handle, const View<double>& times, glm::vec3* positions, glm::vec3* normals = NULL);
+
+	// global matrices of any object, one per time
+	bool evaluate(Handle handle, const View<double>& times, ofMatrix4x4* matrices);
 	
 protected:
 
 	Alembic::AbcGeom::IArchive m_archive;
 
 	ofPtr<IGeom> m_root;
-
-	map<string, IGeom*> object_name_map;
-	map<string, IGeom*> object_fullname_map;
+	Scene m_scene;
+
+	bool m_hdf5;
+	size_t m_num_streams;
+	size_t m_num_updated;
+	ofPtr<ThreadPool> m_pool;
+	ofPtr<Prefetcher> m_prefetcher;
+	size_t m_prefetch_frames;
+	size_t m_prefetch_bytes;
+	ofPtr<FrameCache> m_cache;
+	bool m_indexed_mesh;
+	bool m_baked_xforms;
+	bool m_lazy;
+	bool m_sidecar_index;
+	bool m_index_hit;
+	ofPtr<ArchiveIndex> m_index;
+	vector<IGeom*> m_leaves;
+
+	vector<string> m_subscribed_patterns;
+	vector<Type> m_subscribed_types;
+	vector<bool> m_subscribed; // per scene node, empty without subscriptions
+	vector<bool> m_read; // per scene node, subscribed by get/find
+	vector<size_t> m_active; // leaves evaluated by setTime
+	bool m_active_stale; // m_read changed, setTime rebuilds m_active
+	size_t m_num_skipped;
+
+	size_t m_snapshot_buffers;
+	vector<ofPtr<Snapshot> > m_snapshots; // ring, the front is one of them
+	ofPtr<const Snapshot> m_front; // only accessed through atomic_load/atomic_store
+	bool m_snapshot_stale; // an abandoned frame moved the scene, globals can't be shared
+
+	// setTime and the async thread take turns, setters that change what setTime reads
+	// (subscriptions, pool, prefetcher, cache, mesh layout) hold it as well
+	std::recursive_mutex m_time_mutex;
+	ofPtr<AsyncUpdater> m_async;
+
+	// path -> index into object_arr, built once in open
+	std::unordered_multimap<string, Handle> object_name_map;
+	std::unordered_map<string, Handle> object_fullname_map;
 	
 	vector<IGeom*> object_arr;
 	vector<string> object_name_arr;
@@ -101,7 +307,47 @@ protected:
 	Alembic::AbcGeom::chrono_t m_minTime;
 	Alembic::AbcGeom::chrono_t m_maxTime;
 
-	float current_time;
+	// written by the async thread, read by getTime on any thread
+	std::atomic<float> current_time;
+
+	// false when a newer async request abandoned it
+	bool updateTime(double time, const AsyncUpdater* async = NULL, uint64_t request = 0);
+
+	bool updateLeaf(size_t i, double time);
+	bool publishSnapshot(double time, const AsyncUpdater* async, uint64_t request);
+	void resetSnapshots();
+	bool load(IGeom* o);
+	void updateThreadPool();
+	void resetPrefetcher();
+
+	bool matchSubscription(IGeom* o) const;
+	void updateSubscriptions();
+	void updateActive();
+	size_t applySubscriptions();
+};
+
+// decoded sample that lives outside of its IGeom, used by the prefetcher
+
+class ofxAlembic::SampleData
+{
+public:
+
+	Alembic::AbcGeom::index_t index;
+
+	SampleData() : index(-1) {}
+	virtual ~SampleData() {}
+
+	virtual size_t getMemoryUsage() const = 0;
+};
+
+template <typename T>
+class ofxAlembic::TypedSampleData : public ofxAlembic::SampleData
+{
+public:
+
+	T value;
+
+	size_t getMemoryUsage() const { return value.getMemoryUsage(); }
 };
 
 // Geom
@@ -109,6 +355,10 @@ protected:
 class ofxAlembic::IGeom
 {
 	friend class Reader;
+	friend class Prefetcher;
+	friend class Scene;
+	friend class ArchiveIndex;
+	friend class Snapshot;
 
 public:
 
@@ -116,12 +366,12 @@ public:
 	IGeom(Alembic::AbcGeom::IObject object);
 	virtual ~IGeom();
 
-	virtual bool valid() { return m_object; }
+	virtual bool valid() { return m_object || !m_fullname.empty(); }
 
 	void draw();
 	void debugDraw();
 	
-	inline const ofMatrix4x4& getGlobalTransform() const { return transform; }
+	const ofMatrix4x4& getGlobalTransform() const;
 
 	size_t getIndex() const { return index; }
 	
@@ -135,6 +385,18 @@ public:
 	template <typename T>
 	inline bool isTypeOf() const { return type == type2enum<T>(); }
 
+	// leaf geometry has decoded its constant data, always true for xforms
+	inline bool isLoaded() const { return m_loaded; }
+
+	// false while the reader is in snapshot mode. the live values then keep the data loaded
+	// at open, get copies from the latest published frame and the zero copy accessors
+	// log an error and return nothing, hold Reader::getSnapshot for those instead
+	inline bool isLive() const { return m_snapshots == NULL; }
+
+	// IXform, IPoints, ICurves, IPolyMesh or ICamera, NULL on type mismatch
+	template <typename T>
+	inline T* cast() { return isTypeOf<T>() ? static_cast<T*>(this) : NULL; }
+
 	template <typename T>
 	inline bool get(T &out)
 	{
@@ -147,34 +409,99 @@ protected:
 	Type type;
 	
 	size_t index;
-	ofMatrix4x4 transform;
+
+	// node in the flattened scene, which owns the transforms
+	Scene *m_scene;
+	size_t m_node;
+
+	// nodes built from the sidecar index keep their names and open m_object on first use
+	IGeom *m_parent;
+	string m_name;
+	string m_fullname;
+	std::atomic<bool> m_opened;
 
 	Alembic::AbcGeom::IObject m_object;
 	vector<ofPtr<IGeom> > m_children;
 
+	IGeom(const ArchiveIndex::Entry& entry, IGeom* parent);
+
+	const Alembic::AbcGeom::IObject& object();
+
 	virtual void setupWithObject(Alembic::AbcGeom::IObject);
-	void updateWithTime(double time, Imath::M44f& xform);
 
-	virtual void updateWithTimeInternal(double time, Imath::M44f& xform) {}
+	// set once load() is done, checked by the prefetch thread
+	std::atomic<bool> m_loaded;
+
+	// the owning reader while it is in snapshot mode, set before any other thread reads
+	const Reader *m_snapshots;
+	bool check_live() const;
+
+	// what get copies from, the live value or the one in the latest published frame,
+	// which hold keeps alive. NULL before the first frame
+	const Points* current(const Points& live, ofPtr<const Snapshot>& hold) const;
+	const Curves* current(const Curves& live, ofPtr<const Snapshot>& hold) const;
+	const PolyMesh* current(const PolyMesh& live, ofPtr<const Snapshot>& hold) const;
+	const Camera* current(const Camera& live, ofPtr<const Snapshot>& hold) const;
+	const ofMatrix4x4& current_transform(const ofPtr<const Snapshot>& hold) const;
+
+	// decodes constant data, the reader calls it at open or on first access when lazy
+	virtual void load() { m_loaded = true; }
+
+	// returns false when the time resolves to the sample already held
+	virtual bool updateWithTimeInternal(double time, Imath::M44f& xform) { return false; }
 	virtual void drawInternal() {}
 	virtual void debugDrawInternal() {}
 
+	// animated geometry can decode samples off-thread without touching the current state
+	virtual bool isAnimated() { return false; }
+	virtual Alembic::AbcGeom::index_t getSampleIndex(double time) { return -1; }
+	virtual size_t getNumSamples() { return 0; }
+
+	// decodes into data (reused when it already holds the right type)
+	virtual ofPtr<SampleData> readSample(Alembic::AbcGeom::index_t index, ofPtr<SampleData> data) { return ofPtr<SampleData>(); }
+	// makes data the current sample, data receives the previous one
+	virtual void swapSample(ofPtr<SampleData>& data) {}
+
 	Alembic::AbcGeom::chrono_t m_minTime;
 	Alembic::AbcGeom::chrono_t m_maxTime;
 
-	static void visit_geoms(ofPtr<IGeom> &obj, map<string, IGeom*> &object_name_map, map<string, IGeom*> &object_fullname_map);
-	
+	Alembic::AbcGeom::index_t m_sampleIndex;
+
+	// from the schema, or from the sidecar index until the schema is read
+	bool m_constant;
+	size_t m_numSamples;
+
 	template <typename T>
 	void update_timestamp(T& object);
+
+	template <typename T>
+	bool update_sample_index(T& schema, double time);
+
+	template <typename T>
+	Alembic::AbcGeom::index_t get_sample_index(T& schema, double time);
+
+	template <typename T>
+	TypedSampleData<T>* sample_buffer(ofPtr<SampleData>& data);
+
+	template <typename T, typename Schema>
+	ofPtr<SampleData> read_sample(Schema& schema, Alembic::AbcGeom::index_t index, ofPtr<SampleData> data);
+
+	template <typename T>
+	void swap_sample(T& value, ofPtr<SampleData>& data);
 };
 
 class ofxAlembic::IXform : public ofxAlembic::IGeom
 {
+	friend class Scene;
+	friend class ArchiveIndex;
+
 public:
 	
 	XForm xform;
 	
 	IXform(Alembic::AbcGeom::IXform object);
+	// constant xforms take their matrix from the entry, the schema is read on first use
+	IXform(const ArchiveIndex::Entry& entry, IGeom* parent, Alembic::AbcCoreAbstract::TimeSamplingPtr time_sampling);
 	~IXform();
 	
 	const char* getTypeName() const { return "Xform"; }
@@ -182,8 +509,12 @@ public:
 protected:
 	
 	Alembic::AbcGeom::IXform m_xform;
+	Alembic::AbcCoreAbstract::TimeSamplingPtr m_timeSampling;
+	std::atomic<bool> m_wrapped;
+
+	// safe to call from several threads
+	Alembic::AbcGeom::IXformSchema& getSchema();
 	
-	void updateWithTimeInternal(double time, Imath::M44f& xform);
 	void debugDrawInternal()
 	{
 		ofPushStyle();
@@ -202,11 +533,15 @@ protected:
 
 class ofxAlembic::IPoints : public ofxAlembic::IGeom
 {
+	friend class ArchiveIndex;
+
 public:
 
 	Points points;
 
 	IPoints(Alembic::AbcGeom::IPoints object);
+	// the object is opened on load
+	IPoints(const ArchiveIndex::Entry& entry, IGeom* parent);
 	~IPoints()
 	{
 		if (m_points)
@@ -215,21 +550,48 @@ public:
 
 	const char* getTypeName() const { return "Points"; }
 
+	// zero copy access, valid until the next setTime. empty in snapshot mode
+	inline const vector<Point>& getPoints() const
+	{
+		static const vector<Point> empty;
+		return check_live() ? points.points : empty;
+	}
+	inline View<glm::vec3> getPositions() const
+	{
+		const vector<Point> &p = getPoints();
+		return View<glm::vec3>(p.empty() ? NULL : &p[0].pos, p.size(), sizeof(Point));
+	}
+
+	// see Reader::evaluate, blocks have the size of the current sample
+	bool evaluate(const View<double>& times, glm::vec3* positions, ThreadPool* pool = NULL);
+
 protected:
 
 	Alembic::AbcGeom::IPoints m_points;
 
-	void updateWithTimeInternal(double time, Imath::M44f& xform);
+	void load();
+	bool updateWithTimeInternal(double time, Imath::M44f& xform);
+
+	bool isAnimated() { return !m_constant; }
+	Alembic::AbcGeom::index_t getSampleIndex(double time) { return get_sample_index(m_points.getSchema(), time); }
+	size_t getNumSamples() { return m_numSamples; }
+
+	ofPtr<SampleData> readSample(Alembic::AbcGeom::index_t index, ofPtr<SampleData> data);
+	void swapSample(ofPtr<SampleData>& data);
 	void drawInternal() { points.draw(); }
 };
 
 class ofxAlembic::ICurves : public ofxAlembic::IGeom
 {
+	friend class ArchiveIndex;
+
 public:
 
 	Curves curves;
 
 	ICurves(Alembic::AbcGeom::ICurves object);
+	// the object is opened on load
+	ICurves(const ArchiveIndex::Entry& entry, IGeom* parent);
 	~ICurves()
 	{
 		if (m_curves)
@@ -238,21 +600,40 @@ public:
 
 	const char* getTypeName() const { return "Curves"; }
 
+	// zero copy access, valid until the next setTime. empty in snapshot mode
+	inline const vector<ofPolyline>& getCurves() const
+	{
+		static const vector<ofPolyline> empty;
+		return check_live() ? curves.curves : empty;
+	}
+
 protected:
 
 	Alembic::AbcGeom::ICurves m_curves;
 
-	void updateWithTimeInternal(double time, Imath::M44f& xform);
+	void load();
+	bool updateWithTimeInternal(double time, Imath::M44f& xform);
+
+	bool isAnimated() { return !m_constant; }
+	Alembic::AbcGeom::index_t getSampleIndex(double time) { return get_sample_index(m_curves.getSchema(), time); }
+	size_t getNumSamples() { return m_numSamples; }
+
+	ofPtr<SampleData> readSample(Alembic::AbcGeom::index_t index, ofPtr<SampleData> data);
+	void swapSample(ofPtr<SampleData>& data);
 	void drawInternal() { curves.draw(); }
 };
 
 class ofxAlembic::IPolyMesh : public ofxAlembic::IGeom
 {
+	friend class ArchiveIndex;
+
 public:
 
 	PolyMesh polymesh;
 
 	IPolyMesh(Alembic::AbcGeom::IPolyMesh object);
+	// the object is opened on load
+	IPolyMesh(const ArchiveIndex::Entry& entry, IGeom* parent);
 	~IPolyMesh()
 	{
 		if (m_polyMesh)
@@ -261,11 +642,46 @@ public:
 
 	const char* getTypeName() const { return "PolyMesh"; }
 
+	// zero copy access, valid until the next setTime. empty in snapshot mode
+	inline const ofMesh& getMesh() const
+	{
+		static const ofMesh empty;
+		return check_live() ? polymesh.mesh : empty;
+	}
+	inline View<glm::vec3> getPositions() const { return View<glm::vec3>(getMesh().getVertices()); }
+	inline View<glm::vec3> getNormals() const { return View<glm::vec3>(getMesh().getNormals()); }
+	inline View<glm::vec2> getTexCoords() const { return View<glm::vec2>(getMesh().getTexCoords()); }
+	inline View<ofIndexType> getIndices() const { return View<ofIndexType>(getMesh().getIndices()); }
+
+	// switches between triangle soup and indexed output, the current sample is decoded again
+	// when loaded, otherwise the mode is only stored for load()
+	void setIndexed(bool indexed);
+	inline bool isIndexed() const { return m_topology.indexed; }
+
+	// large meshes split their triangulation and gathers over this pool
+	void setThreadPool(ThreadPool *pool) { m_pool = pool; }
+
+	// see Reader::evaluate
+	size_t getNumEvaluatedVertices() const;
+	bool evaluate(const View<double>& times, glm::vec3* positions, glm::vec3* normals = NULL, ThreadPool* pool = NULL);
+
 protected:
 
 	Alembic::AbcGeom::IPolyMesh m_polyMesh;
 
-	void updateWithTimeInternal(double time, Imath::M44f& xform);
+	// built once at open for homogeneous topology, read-only afterwards
+	MeshTopology m_topology;
+	ThreadPool *m_pool;
+
+	void load();
+	bool updateWithTimeInternal(double time, Imath::M44f& xform);
+
+	bool isAnimated() { return !m_constant; }
+	Alembic::AbcGeom::index_t getSampleIndex(double time) { return get_sample_index(m_polyMesh.getSchema(), time); }
+	size_t getNumSamples() { return m_numSamples; }
+
+	ofPtr<SampleData> readSample(Alembic::AbcGeom::index_t index, ofPtr<SampleData> data);
+	void swapSample(ofPtr<SampleData>& data);
 	void drawInternal() { polymesh.draw(); }
 };
 
@@ -276,6 +692,8 @@ public:
 	Camera camera;
 	
 	ICamera(Alembic::AbcGeom::ICamera object);
+	// the object is opened on load
+	ICamera(const ArchiveIndex::Entry& entry, IGeom* parent);
 	~ICamera()
 	{
 		if (m_camera)
@@ -288,13 +706,35 @@ protected:
 	
 	Alembic::AbcGeom::ICamera m_camera;
 	
-	void updateWithTimeInternal(double time, Imath::M44f& xform);
+	void load();
+	bool updateWithTimeInternal(double time, Imath::M44f& xform);
+
+	bool isAnimated() { return !m_constant; }
+	Alembic::AbcGeom::index_t getSampleIndex(double time) { return get_sample_index(m_camera.getSchema(), time); }
+	size_t getNumSamples() { return m_numSamples; }
+
+	ofPtr<SampleData> readSample(Alembic::AbcGeom::index_t index, ofPtr<SampleData> data);
+	void swapSample(ofPtr<SampleData>& data);
 	void drawInternal() { camera.draw(); }
 
 };
 
 //
 
+template <typename T>
+inline T* ofxAlembic::Reader::find(const string& path)
+{
+	return find<T>(resolve(path));
+}
+
+template <typename T>
+inline T* ofxAlembic::Reader::find(Handle handle)
+{
+	IGeom *o = get(handle);
+	if (o == NULL) return NULL;
+	return o->cast<T>();
+}
+
 template <>
 inline bool ofxAlembic::IGeom::get(ofMatrix4x4 &o)
 {
@@ -303,8 +743,15 @@ inline bool ofxAlembic::IGeom::get(ofMatrix4x4 &o)
 		ofLogError("ofxAlembic::IXform") << "cast error";
 		return false;
 	}
-	
-	o = transform;
+
+	ofPtr<const Snapshot> hold;
+	if (m_snapshots)
+	{
+		hold = m_snapshots->getSnapshot();
+		if (!hold) return false;
+	}
+
+	o = current_transform(hold);
 	return true;
 }
 
@@ -317,7 +764,11 @@ inline bool ofxAlembic::IGeom::get(ofxAlembic::Points &o)
 		return false;
 	}
 
-	o = ((IPoints*)this)->points;
+	ofPtr<const Snapshot> hold;
+	const Points *p = current(((IPoints*)this)->points, hold);
+	if (p == NULL) return false;
+
+	o = *p;
 	return true;
 }
 
@@ -330,7 +781,11 @@ inline bool ofxAlembic::IGeom::get(vector<ofxAlembic::Point> &o)
 		return false;
 	}
 
-	o = ((IPoints*)this)->points.points;
+	ofPtr<const Snapshot> hold;
+	const Points *p = current(((IPoints*)this)->points, hold);
+	if (p == NULL) return false;
+
+	o = p->points;
 	return true;
 }
 
@@ -343,7 +798,15 @@ inline bool ofxAlembic::IGeom::get(std::vector<glm::vec3> &o)
 		return false;
 	}
 
-	o = toOf(((IPoints*)this)->points.points);
+	ofPtr<const Snapshot> hold;
+	const Points *points = current(((IPoints*)this)->points, hold);
+	if (points == NULL) return false;
+
+	// reuse the caller's storage instead of allocating a new vector
+	const vector<ofxAlembic::Point> &p = points->points;
+	o.resize(p.size());
+	for (int i = 0; i < p.size(); i++)
+		o[i] = p[i].pos;
 	return true;
 }
 
@@ -356,7 +819,11 @@ inline bool ofxAlembic::IGeom::get(ofxAlembic::Curves &o)
 		return false;
 	}
 
-	o = ((ICurves*)this)->curves;
+	ofPtr<const Snapshot> hold;
+	const Curves *c = current(((ICurves*)this)->curves, hold);
+	if (c == NULL) return false;
+
+	o = *c;
 	return true;
 }
 
@@ -369,7 +836,11 @@ inline bool ofxAlembic::IGeom::get(vector<ofPolyline> &o)
 		return false;
 	}
 
-	o = ((ICurves*)this)->curves.curves;
+	ofPtr<const Snapshot> hold;
+	const Curves *c = current(((ICurves*)this)->curves, hold);
+	if (c == NULL) return false;
+
+	o = c->curves;
 	return true;
 }
 
@@ -382,7 +853,11 @@ inline bool ofxAlembic::IGeom::get(ofxAlembic::PolyMesh &o)
 		return false;
 	}
 
-	o = ((IPolyMesh*)this)->polymesh;
+	ofPtr<const Snapshot> hold;
+	const PolyMesh *p = current(((IPolyMesh*)this)->polymesh, hold);
+	if (p == NULL) return false;
+
+	o = *p;
 	return true;
 }
 
@@ -395,7 +870,11 @@ inline bool ofxAlembic::IGeom::get(ofMesh &o)
 		return false;
 	}
 
-	o = ((IPolyMesh*)this)->polymesh.mesh;
+	ofPtr<const Snapshot> hold;
+	const PolyMesh *p = current(((IPolyMesh*)this)->polymesh, hold);
+	if (p == NULL) return false;
+
+	o = p->mesh;
 	return true;
 }
 
@@ -407,7 +886,11 @@ inline bool ofxAlembic::IGeom::get(ofCamera &o)
 		ofLogError("ofxAlembic::IGeom") << "cast error";
 		return false;
 	}
+
+	ofPtr<const Snapshot> hold;
+	const Camera *c = current(((ICamera*)this)->camera, hold);
+	if (c == NULL) return false;
 	
-	((ICamera*)this)->camera.updateParams(o, transform);
+	c->updateParams(o, current_transform(hold));
 	return true;
 }
\ No newline at end of file
@@ -0,0 +1,380 @@
+#include "ofxAlembicScene.h"
+#include "ofxAlembicReader.h"
+
+using namespace ofxAlembic;
+using namespace Alembic::AbcGeom;
+
+void Scene::build(IGeom* root)
+{
+	clear();
+
+	// explicit stack, children pushed in reverse to keep the original order
+	vector<pair<IGeom*, int> > stack;
+	stack.push_back(make_pair(root, -1));
+
+	vector<bool> is_dynamic;
+
+	while (!stack.empty())
+	{
+		IGeom *o = stack.back().first;
+		int parent = stack.back().second;
+		stack.pop_back();
+
+		size_t node = geoms.size();
+
+		o->m_scene = this;
+		o->m_node = node;
+
+		geoms.push_back(o);
+		parents.push_back(parent);
+		types.push_back(o->type);
+		sample_indices.push_back(-1);
+		stamps.push_back(0);
+		is_dynamic.push_back(parent >= 0 && is_dynamic[parent]);
+
+		if (o->isTypeOf(XFORM))
+		{
+			ofxAlembic::IXform *x = (ofxAlembic::IXform*)o;
+
+			locals.push_back(toOf(x->xform.mat));
+
+			// xforms built from a sidecar index haven't read their schema yet
+			if (!o->m_constant)
+			{
+				is_dynamic[node] = true;
+
+				animated.push_back(node);
+				time_samplings.push_back(x->m_timeSampling);
+				num_samples.push_back(o->m_numSamples);
+				min_times.push_back(o->m_minTime);
+				max_times.push_back(o->m_maxTime);
+			}
+		}
+		else
+		{
+			locals.push_back(ofMatrix4x4());
+
+			if (!o->isTypeOf(UNKHOWN))
+				leaves.push_back(o);
+		}
+
+		if (is_dynamic[node])
+			dynamic.push_back(node);
+
+		for (int i = o->m_children.size() - 1; i >= 0; i--)
+			stack.push_back(make_pair(o->m_children[i].get(), (int)node));
+	}
+
+	globals.resize(geoms.size());
+	updateGlobals();
+
+	setActive(vector<bool>());
+	refresh = false;
+}
+
+void Scene::clear()
+{
+	for (int i = 0; i < geoms.size(); i++)
+		geoms[i]->m_scene = NULL;
+
+	geoms.clear();
+	parents.clear();
+	types.clear();
+	locals.clear();
+	globals.clear();
+	sample_indices.clear();
+	stamps.clear();
+
+	animated.clear();
+	time_samplings.clear();
+	num_samples.clear();
+	min_times.clear();
+	max_times.clear();
+
+	unbake();
+
+	dynamic.clear();
+	active_animated.clear();
+	active_dynamic.clear();
+	refresh = false;
+
+	leaves.clear();
+}
+
+size_t Scene::update(double time, bool hdf5, ThreadPool* pool)
+{
+	size_t num_updated = 0;
+
+	// 0 is never current, so nothing counts as changed before the first update
+	if (++stamp == 0) stamp = 1;
+
+	// HDF5 reads are serialized anyway, small sets aren't worth the dispatch
+	if (pool && !hdf5 && active_animated.size() > 128)
+	{
+		std::atomic<size_t> num(0);
+
+		pool->parallelFor(0, active_animated.size(), [&](size_t k)
+		{
+			if (updateXform(active_animated[k], time))
+				num++;
+		}, 64);
+
+		num_updated = num;
+	}
+	else
+	{
+		std::unique_lock<std::recursive_mutex> lock(getHDF5Mutex(), std::defer_lock);
+		if (hdf5) lock.lock();
+
+		for (int k = 0; k < active_animated.size(); k++)
+		{
+			if (updateXform(active_animated[k], time))
+				num_updated++;
+		}
+	}
+
+	if (refresh)
+	{
+		updateGlobals();
+		num_recomputed = geoms.size();
+		refresh = false;
+	}
+	else if (num_updated > 0)
+	{
+		updateDynamicGlobals();
+	}
+	else
+	{
+		num_recomputed = 0;
+	}
+
+	return num_updated;
+}
+
+bool Scene::updateXform(size_t i, double time)
+{
+	// out of range keeps the last decoded sample
+	if (!ofInRange(time, min_times[i], max_times[i])) return false;
+
+	ISampleSelector ss(time, ISampleSelector::kNearIndex);
+	index_t index = ss.getIndex(time_samplings[i], num_samples[i]);
+
+	size_t node = animated[i];
+	if (index == sample_indices[node]) return false;
+
+	ofxAlembic::IXform *x = (ofxAlembic::IXform*)geoms[node];
+	if (baked)
+		x->xform.mat = baked_samples[baked_offsets[i] + index];
+	else
+		x->xform.set(x->getSchema(), ISampleSelector(index));
+
+	locals[node] = toOf(x->xform.mat);
+	sample_indices[node] = index;
+	stamps[node] = stamp;
+
+	return true;
+}
+
+void Scene::updateGlobals()
+{
+	const size_t n = geoms.size();
+	if (n == 0) return;
+
+	globals[0] = locals[0];
+
+	for (size_t i = 1; i < n; i++)
+	{
+		const ofMatrix4x4 &parent = globals[parents[i]];
+
+		if (types[i] == XFORM)
+			globals[i] = locals[i] * parent;
+		else
+			globals[i] = parent;
+	}
+}
+
+ofMatrix4x4 Scene::evaluate(size_t node, double time) const
+{
+	ofMatrix4x4 m;
+
+	// global = local * parent global, so the chain multiplies up from the node
+	for (int i = node; i >= 0; i = parents[i])
+	{
+		if (types[i] != XFORM) continue;
+
+		// animated holds nodes in ascending order
+		vector<size_t>::const_iterator it = std::lower_bound(animated.begin(), animated.end(), (size_t)i);
+		if (it == animated.end() || *it != i)
+		{
+			m = m * locals[i];
+			continue;
+		}
+
+		const size_t k = it - animated.begin();
+
+		// out of range times land on the first or last sample
+		ISampleSelector ss(time, ISampleSelector::kNearIndex);
+		index_t index = ss.getIndex(time_samplings[k], num_samples[k]);
+
+		if (baked)
+		{
+			m = m * toOf(baked_samples[baked_offsets[k] + index]);
+		}
+		else
+		{
+			ofxAlembic::IXform *x = (ofxAlembic::IXform*)geoms[i];
+
+			XForm xform;
+			xform.set(x->getSchema(), ISampleSelector(index));
+			m = m * toOf(xform.mat);
+		}
+	}
+
+	return m;
+}
+
+void Scene::setActive(const vector<bool>& nodes)
+{
+	active_animated.clear();
+	active_dynamic.clear();
+
+	if (nodes.empty())
+	{
+		for (size_t i = 0; i < animated.size(); i++)
+			active_animated.push_back(i);
+
+		active_dynamic = dynamic;
+	}
+	else
+	{
+		// children come after their parents, one backwards sweep flags every ancestor
+		vector<bool> active(nodes);
+		active.resize(geoms.size(), false);
+
+		for (size_t i = geoms.size(); i-- > 1;)
+		{
+			if (active[i])
+				active[parents[i]] = true;
+		}
+
+		for (size_t i = 0; i < animated.size(); i++)
+		{
+			if (active[animated[i]])
+				active_animated.push_back(i);
+		}
+
+		for (size_t k = 0; k < dynamic.size(); k++)
+		{
+			if (active[dynamic[k]])
+				active_dynamic.push_back(dynamic[k]);
+		}
+	}
+
+	refresh = true;
+}
+
+void Scene::bake(bool hdf5, ThreadPool* pool)
+{
+	unbake();
+
+	baked_offsets.resize(animated.size());
+
+	size_t total = 0;
+	for (int i = 0; i < animated.size(); i++)
+	{
+		baked_offsets[i] = total;
+		total += num_samples[i];
+	}
+
+	baked_samples.resize(total);
+
+	auto read = [&](size_t i)
+	{
+		ofxAlembic::IXform *x = (ofxAlembic::IXform*)geoms[animated[i]];
+		IXformSchema &schema = x->getSchema();
+
+		XForm xform;
+		for (size_t s = 0; s < num_samples[i]; s++)
+		{
+			xform.set(schema, ISampleSelector((index_t)s));
+			baked_samples[baked_offsets[i] + s] = xform.mat;
+		}
+	};
+
+	if (pool && !hdf5)
+	{
+		pool->parallelFor(0, animated.size(), read, 16);
+	}
+	else
+	{
+		std::unique_lock<std::recursive_mutex> lock(getHDF5Mutex(), std::defer_lock);
+		if (hdf5) lock.lock();
+
+		for (size_t i = 0; i < animated.size(); i++)
+			read(i);
+	}
+
+	baked = true;
+}
+
+void Scene::unbake()
+{
+	baked = false;
+
+	vector<Imath::M44f>().swap(baked_samples);
+	vector<size_t>().swap(baked_offsets);
+}
+
+size_t Scene::getBakedMemoryUsage() const
+{
+	return baked_samples.capacity() * sizeof(Imath::M44f) + baked_offsets.capacity() * sizeof(size_t);
+}
+
+void Scene::updateDynamicGlobals()
+{
+	num_recomputed = 0;
+
+	// static parents never carry the current stamp, their globals were baked in build.
+	// parents of active nodes are active themselves
+	for (size_t k = 0; k < active_dynamic.size(); k++)
+	{
+		const size_t i = active_dynamic[k];
+		const int p = parents[i];
+
+		if (stamps[i] != stamp && stamps[p] != stamp) continue;
+		stamps[i] = stamp;
+
+		if (types[i] == XFORM)
+			globals[i] = locals[i] * globals[p];
+		else
+			globals[i] = globals[p];
+
+		num_recomputed++;
+	}
+}
+
+void Scene::draw()
+{
+	for (size_t i = 0; i < geoms.size(); i++)
+	{
+		// xforms draw nothing themselves
+		if (types[i] == XFORM || types[i] == UNKHOWN) continue;
+		if (!geoms[i]->m_loaded) continue;
+
+		ofPushMatrix();
+		ofMultMatrix(globals[i]);
+		geoms[i]->drawInternal();
+		ofPopMatrix();
+	}
+}
+
+void Scene::debugDraw()
+{
+	for (size_t i = 0; i < geoms.size(); i++)
+	{
+		ofPushMatrix();
+		ofMultMatrix(globals[i]);
+		geoms[i]->debugDrawInternal();
+		ofPopMatrix();
+	}
+}
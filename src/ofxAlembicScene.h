@@ -0,0 +1,112 @@
+#pragma once
+
+#include "ofxAlembicUtil.h"
+#include "ofxAlembicThreadPool.h"
+
+namespace ofxAlembic
+{
+class Scene;
+class IGeom;
+}
+
+// the object hierarchy flattened into parallel arrays in depth first order.
+// parents always come before their children, so global matrices resolve in
+// one linear sweep. IGeom objects stay as facades and read their transform from here.
+// globals of nodes without an animated xform above them are baked once in build()
+
+class ofxAlembic::Scene
+{
+public:
+
+	Scene() : baked(false), refresh(false), stamp(0), num_recomputed(0) {}
+
+	void build(IGeom* root);
+	void clear();
+
+	inline size_t size() const { return geoms.size(); }
+
+	// decodes animated xforms at time and re-multiplies the chains below the ones
+	// that changed, returns the number of xforms that decoded a new sample
+	size_t update(double time, bool hdf5, ThreadPool* pool = NULL);
+
+	// global = local * parent global over all nodes
+	void updateGlobals();
+
+	// update only decodes animated xforms at or above flagged nodes and only
+	// re-multiplies their chains, empty flags make every node active again
+	void setActive(const vector<bool>& nodes);
+
+	// global matrix of node at time, decoded on the side without touching the current
+	// state. hold the HDF5 lock for HDF5 archives
+	ofMatrix4x4 evaluate(size_t node, double time) const;
+
+	// animated xforms update leaves alone because nothing below them is active
+	inline size_t getNumSkipped() const { return animated.size() - active_animated.size(); }
+
+	// reads every sample of every animated xform into one table, update then
+	// only indexes it instead of going through the schema
+	void bake(bool hdf5, ThreadPool* pool = NULL);
+	void unbake();
+	inline bool isBaked() const { return baked; }
+	size_t getBakedMemoryUsage() const;
+
+	// globals recomputed by the last update, only chains below an xform that changed
+	inline size_t getNumRecomputed() const { return num_recomputed; }
+
+	void draw();
+	void debugDraw();
+
+	inline IGeom* getGeom(size_t node) const { return geoms[node]; }
+	inline int getParent(size_t node) const { return parents[node]; }
+	inline Type getType(size_t node) const { return types[node]; }
+	inline const ofMatrix4x4& getLocalTransform(size_t node) const { return locals[node]; }
+	inline const ofMatrix4x4& getGlobalTransform(size_t node) const { return globals[node]; }
+	inline const vector<ofMatrix4x4>& getGlobalTransforms() const { return globals; }
+
+	// non xform geometry in depth first order
+	inline const vector<IGeom*>& getLeaves() const { return leaves; }
+	inline size_t getNumAnimatedXforms() const { return animated.size(); }
+
+	// nodes below an animated xform, everything else is static
+	inline size_t getNumDynamicNodes() const { return dynamic.size(); }
+
+protected:
+
+	// per node
+	vector<IGeom*> geoms;
+	vector<int> parents; // -1 for the root
+	vector<Type> types;
+	vector<ofMatrix4x4> locals; // identity for everything but xforms
+	vector<ofMatrix4x4> globals;
+	vector<Alembic::AbcGeom::index_t> sample_indices; // current xform sample, -1 if constant
+	vector<uint32_t> stamps; // update count of the last change, tells which chains to recompute
+
+	// per animated xform
+	vector<size_t> animated;
+	vector<Alembic::AbcGeom::TimeSamplingPtr> time_samplings;
+	vector<size_t> num_samples;
+	vector<Alembic::AbcGeom::chrono_t> min_times;
+	vector<Alembic::AbcGeom::chrono_t> max_times;
+	vector<size_t> baked_offsets; // first sample in baked_samples
+
+	bool baked;
+	vector<Imath::M44f> baked_samples;
+
+	// nodes that have an animated xform at or above them, in depth first order
+	vector<size_t> dynamic;
+
+	// subsets of animated (as indices into it) and dynamic evaluated by update
+	vector<size_t> active_animated;
+	vector<size_t> active_dynamic;
+
+	// inactive chains may be stale, the next update recomputes every global
+	bool refresh;
+
+	vector<IGeom*> leaves;
+
+	uint32_t stamp;
+	size_t num_recomputed;
+
+	bool updateXform(size_t i, double time);
+	void updateDynamicGlobals();
+};
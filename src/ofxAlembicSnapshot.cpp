@@ -0,0 +1,79 @@
+#include "ofxAlembicSnapshot.h"
+
+using namespace ofxAlembic;
+
+const ofMatrix4x4& Snapshot::getGlobalTransform(const IGeom* o) const
+{
+	static const ofMatrix4x4 identity;
+
+	if (!globals || o->m_node >= globals->size()) return identity;
+	return (*globals)[o->m_node];
+}
+
+template <typename T>
+const T* Snapshot::value(const IGeom* o, const T& live) const
+{
+	if (!o->m_loaded) return NULL;
+
+	if (o->m_node < samples.size())
+	{
+		const TypedSampleData<T> *typed = dynamic_cast<const TypedSampleData<T>*>(samples[o->m_node].get());
+		if (typed) return &typed->value;
+	}
+
+	// constant data is written once by load and only read afterwards
+	return &live;
+}
+
+const Points* Snapshot::getPoints(const IGeom* o) const
+{
+	if (o == NULL || !o->isTypeOf(POINTS)) return NULL;
+	return value(o, static_cast<const IPoints*>(o)->points);
+}
+
+const Curves* Snapshot::getCurves(const IGeom* o) const
+{
+	if (o == NULL || !o->isTypeOf(CURVES)) return NULL;
+	return value(o, static_cast<const ICurves*>(o)->curves);
+}
+
+const PolyMesh* Snapshot::getPolyMesh(const IGeom* o) const
+{
+	if (o == NULL || !o->isTypeOf(POLYMESH)) return NULL;
+	return value(o, static_cast<const IPolyMesh*>(o)->polymesh);
+}
+
+const Camera* Snapshot::getCamera(const IGeom* o) const
+{
+	if (o == NULL || !o->isTypeOf(CAMERA)) return NULL;
+	return value(o, static_cast<const ICamera*>(o)->camera);
+}
+
+void Snapshot::draw(const Scene& scene) const
+{
+	// a snapshot from before the last open has nothing to draw
+	if (!globals || globals->size() != scene.size()) return;
+
+	for (size_t i = 0; i < scene.size(); i++)
+	{
+		const IGeom *o = scene.getGeom(i);
+
+		const Type type = scene.getType(i);
+		if (type == XFORM || type == UNKHOWN) continue;
+		if (!o->m_loaded) continue;
+
+		ofPushMatrix();
+		ofMultMatrix((*globals)[i]);
+
+		switch (type)
+		{
+			case POINTS: getPoints(o)->draw(); break;
+			case CURVES: getCurves(o)->draw(); break;
+			case POLYMESH: getPolyMesh(o)->draw(); break;
+			case CAMERA: getCamera(o)->draw(); break;
+			default: break;
+		}
+
+		ofPopMatrix();
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ofxAlembicReader.h"
+
+namespace ofxAlembic
+{
+class Snapshot;
+}
+
+// one published frame of a reader in snapshot mode. it never changes after
+// publishing, so any thread can read it while the next frame is decoded.
+// buffers that didn't change are shared with the previous frame
+
+class ofxAlembic::Snapshot
+{
+	friend class Reader;
+
+public:
+
+	Snapshot() : time(0), frame(0) {}
+
+	inline double getTime() const { return time; }
+
+	// counts publishes since open, tells a reader whether a newer frame is out
+	inline uint64_t getFrame() const { return frame; }
+
+	const ofMatrix4x4& getGlobalTransform(const IGeom* o) const;
+
+	// value in this frame, the decoded sample of animated leaves or the constant data
+	// loaded at open. NULL on type mismatch and for leaves that aren't loaded
+	const Points* getPoints(const IGeom* o) const;
+	const Curves* getCurves(const IGeom* o) const;
+	const PolyMesh* getPolyMesh(const IGeom* o) const;
+	const Camera* getCamera(const IGeom* o) const;
+
+	// same as Reader::draw, for the objects of scene
+	void draw(const Scene& scene) const;
+
+protected:
+
+	double time;
+	uint64_t frame;
+
+	// per scene node, shared with the previous frame when no xform changed
+	ofPtr<vector<ofMatrix4x4> > globals;
+
+	// per scene node, NULL for xforms and for leaves without a decoded sample
+	vector<ofPtr<SampleData> > samples;
+
+	template <typename T>
+	const T* value(const IGeom* o, const T& live) const;
+};
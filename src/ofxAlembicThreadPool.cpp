@@ -0,0 +1,176 @@
+#include "ofxAlembicThreadPool.h"
+
+#include <algorithm>
+#include <exception>
+
+using namespace ofxAlembic;
+
+static const size_t NO_WORKER = (size_t)-1;
+
+static thread_local ThreadPool* current_pool = NULL;
+static thread_local size_t current_index = NO_WORKER;
+
+ThreadPool::ThreadPool(size_t num_threads) : num_pending(0), next_queue(0), running(true)
+{
+	if (num_threads == 0)
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	for (size_t i = 0; i < num_threads; i++)
+		queues.push_back(new Queue);
+
+	for (size_t i = 0; i < num_threads; i++)
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		running = false;
+	}
+	sleep_cond.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	for (size_t i = 0; i < queues.size(); i++)
+		delete queues[i];
+}
+
+void ThreadPool::submit(const Task& task)
+{
+	// workers push to their own deque, other threads spread round robin
+	size_t index = (current_pool == this) ? current_index : next_queue++ % queues.size();
+
+	num_pending++;
+
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+		queues[index]->tasks.push_back(task);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	sleep_cond.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, const std::function<void(size_t)>& fn, size_t grain)
+{
+	if (end <= begin) return;
+
+	const size_t num = end - begin;
+	grain = std::max<size_t>(grain, 1);
+
+	// a few chunks per worker so stealing can even out unbalanced objects
+	size_t num_chunks = std::min((num + grain - 1) / grain, workers.size() * 4);
+	num_chunks = std::max<size_t>(num_chunks, 1);
+
+	std::atomic<size_t> remaining(num_chunks);
+	std::exception_ptr error;
+	std::mutex error_mutex;
+
+	// the last chunk wakes the caller once it has nothing left to run
+	std::mutex done_mutex;
+	std::condition_variable done_cond;
+
+	for (size_t c = 0; c < num_chunks; c++)
+	{
+		const size_t b = begin + num * c / num_chunks;
+		const size_t e = begin + num * (c + 1) / num_chunks;
+
+		submit([&, b, e]()
+		{
+			try
+			{
+				for (size_t i = b; i < e; i++)
+					fn(i);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(error_mutex);
+				if (!error) error = std::current_exception();
+			}
+
+			// decremented under the lock, the caller can't return and destroy it in between
+			std::lock_guard<std::mutex> lock(done_mutex);
+			if (--remaining == 0)
+				done_cond.notify_all();
+		});
+	}
+
+	size_t self = (current_pool == this) ? current_index : NO_WORKER;
+	while (remaining > 0 && runOne(self)) {}
+
+	{
+		std::unique_lock<std::mutex> lock(done_mutex);
+		done_cond.wait(lock, [&]() { return remaining == 0; });
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+	current_pool = this;
+	current_index = index;
+
+	while (true)
+	{
+		if (runOne(index)) continue;
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		sleep_cond.wait(lock, [this]() { return num_pending > 0 || !running; });
+
+		if (!running && num_pending == 0) break;
+	}
+
+	current_pool = NULL;
+	current_index = NO_WORKER;
+}
+
+bool ThreadPool::runOne(size_t index)
+{
+	Task task;
+	if (!pop(index, task) && !steal(index, task))
+		return false;
+
+	num_pending--;
+	task();
+	return true;
+}
+
+bool ThreadPool::pop(size_t index, Task& task)
+{
+	if (index == NO_WORKER) return false;
+
+	// own deque is LIFO for cache locality
+	Queue *q = queues[index];
+	std::lock_guard<std::mutex> lock(q->mutex);
+	if (q->tasks.empty()) return false;
+
+	task = q->tasks.back();
+	q->tasks.pop_back();
+	return true;
+}
+
+bool ThreadPool::steal(size_t index, Task& task)
+{
+	const size_t num = queues.size();
+	const size_t start = (index == NO_WORKER) ? 0 : index + 1;
+
+	for (size_t i = 0; i < num; i++)
+	{
+		Queue *q = queues[(start + i) % num];
+		std::unique_lock<std::mutex> lock(q->mutex, std::try_to_lock);
+		if (!lock.owns_lock() || q->tasks.empty()) continue;
+
+		// steal the oldest task
+		task = q->tasks.front();
+		q->tasks.pop_front();
+		return true;
+	}
+
+	return false;
+}
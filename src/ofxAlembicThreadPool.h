@@ -0,0 +1,58 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <functional>
+
+namespace ofxAlembic
+{
+class ThreadPool;
+}
+
+// work-stealing pool, each worker owns a deque and steals from the others when it runs dry
+
+class ofxAlembic::ThreadPool
+{
+public:
+
+	typedef std::function<void()> Task;
+
+	// num_threads == 0 means std::thread::hardware_concurrency()
+	ThreadPool(size_t num_threads = 0);
+	~ThreadPool();
+
+	inline size_t getNumThreads() const { return workers.size(); }
+
+	void submit(const Task& task);
+
+	// runs fn(i) for i in [begin, end), the calling thread helps while there are chunks
+	// to take and sleeps until the ones running elsewhere are done
+	void parallelFor(size_t begin, size_t end, const std::function<void(size_t)>& fn, size_t grain = 1);
+
+protected:
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<Queue*> queues;
+
+	std::mutex sleep_mutex;
+	std::condition_variable sleep_cond;
+
+	std::atomic<size_t> num_pending;
+	std::atomic<size_t> next_queue;
+	std::atomic<bool> running;
+
+	void workerLoop(size_t index);
+	bool runOne(size_t index);
+	bool pop(size_t index, Task& task);
+	bool steal(size_t index, Task& task);
+};
@@ -1,4 +1,6 @@
 #include "ofxAlembicType.h"
+#include "ofxAlembicGather.h"
+#include "ofxAlembicThreadPool.h"
 
 using namespace ofxAlembic;
 using namespace Alembic::AbcGeom;
@@ -71,7 +73,15 @@ inline static ofVec3f toEulerXYZ(const ofMatrix4x4 &m)
 
 void XForm::get(Alembic::AbcGeom::OXformSchema &schema) const
 {
-	XformSample samp;
+	Output out;
+	convert(out);
+	out.write(schema);
+}
+
+void XForm::convert(Output &out) const
+{
+	XformSample &samp = out.sample;
+	samp.reset();
 	
 	XformOp transop(kTranslateOperation, kTranslateHint);
 	XformOp rotatop(kRotateOperation, kRotateHint);
@@ -89,14 +99,15 @@ void XForm::get(Alembic::AbcGeom::OXformSchema &schema) const
 	samp.addOp(rotatop, V3d(0.0, 1.0, 0.0), xyz.y);
 	samp.addOp(rotatop, V3d(0.0, 0.0, 1.0), xyz.z);
 	samp.addOp(scaleop, toAbc(s));
-
-	schema.set(samp);
 }
 
 void XForm::set(Alembic::AbcGeom::IXformSchema &schema, float time)
 {
-	ISampleSelector ss(time, ISampleSelector::kNearIndex);
-	
+	set(schema, ISampleSelector(time, ISampleSelector::kNearIndex));
+}
+
+void XForm::set(Alembic::AbcGeom::IXformSchema &schema, const ISampleSelector &ss)
+{
 	const M44d& m = schema.getValue(ss).getMatrix();
 	const double *src = m.getValue();
 	float *dst = mat.getValue();
@@ -116,18 +127,28 @@ Points::Points(const vector<glm::vec3>& ofpoints)
 }
 
 void Points::get(OPointsSchema &schema) const
+{
+	Output out;
+	convert(out);
+	out.write(schema);
+}
+
+void Points::convert(Output &out) const
 {
 	int num = points.size();
 
-	vector<V3f> positions(num);
-	vector<uint64_t> ids(num);
+	out.positions.resize(num);
+	out.ids.resize(num);
 
 	for (int i = 0; i < num; i++)
 	{
-		positions[i] = toAbc(points[i].pos);
-		ids[i] = points[i].id;
+		out.positions[i] = toAbc(points[i].pos);
+		out.ids[i] = points[i].id;
 	}
+}
 
+void Points::Output::write(OPointsSchema &schema)
+{
 	OPointsSchema::Sample sample((P3fArraySample(positions)),
 								 UInt64ArraySample(ids));
 	schema.set(sample);
@@ -135,7 +156,11 @@ void Points::get(OPointsSchema &schema) const
 
 void Points::set(IPointsSchema &schema, float time)
 {
-	ISampleSelector ss(time, ISampleSelector::kNearIndex);
+	set(schema, ISampleSelector(time, ISampleSelector::kNearIndex));
+}
+
+void Points::set(IPointsSchema &schema, const ISampleSelector &ss)
+{
 	IPointsSchema::Sample sample;
 	schema.get(sample, ss);
 
@@ -154,7 +179,7 @@ void Points::set(IPointsSchema &schema, float time)
 	}
 }
 
-void Points::draw()
+void Points::draw() const
 {
 	ofVboMesh vbomesh;
 	for (auto& p : points)
@@ -164,159 +189,400 @@ void Points::draw()
 
 #pragma mark - PolyMesh
 
-void PolyMesh::get(OPolyMeshSchema &schema) const
+static std::atomic<size_t> parallel_threshold(250000);
+
+void PolyMesh::setParallelThreshold(size_t num)
 {
-	vector<V3f> positions;
-	vector<int32_t> indexes;
-	vector<int32_t> counts;
-	vector<V2f> uvs;
-	vector<N3f> norms;
+	parallel_threshold = num;
+}
 
-	OV2fGeomParam::Sample uv_sample;
-	ON3fGeomParam::Sample norm_sample;
+size_t PolyMesh::getParallelThreshold()
+{
+	return parallel_threshold;
+}
 
-	if (mesh.getNumIndices())
+// runs fn over [0, num) in contiguous ranges, split on the pool when the mesh is big enough
+static void for_ranges(ThreadPool *pool, size_t num, const std::function<void(size_t, size_t)>& fn)
+{
+	if (pool == NULL || num < parallel_threshold)
 	{
-		const int num_samples = mesh.getNumIndices();
+		fn(0, num);
+		return;
+	}
 
-		const vector<ofIndexType>& idx = mesh.getIndices();
+	const size_t num_chunks = pool->getNumThreads() * 4;
+	pool->parallelFor(0, num_chunks, [&](size_t c)
+	{
+		fn(num * c / num_chunks, num * (c + 1) / num_chunks);
+	});
+}
 
-		{
-			indexes.resize(num_samples);
-			for (int i = 0; i < num_samples; i++)
-				indexes[i] = i;
-		}
+// vertex and varying scoped values follow P, anything else is taken per face corner
+static bool is_per_point(GeometryScope scope)
+{
+	return scope == kVertexScope || scope == kVaryingScope;
+}
 
-		{
-			const std::vector<glm::vec3>& verts = mesh.getVertices();
-			positions.resize(num_samples);
+void PolyMesh::get(OPolyMeshSchema &schema) const
+{
+	get(schema, true, true);
+}
 
-			for (int i = 0; i < num_samples; i++)
-				positions[i] = toAbc(verts[idx[i]]);
-		}
+void PolyMesh::get(OPolyMeshSchema &schema, bool topology, bool normals) const
+{
+	Output out;
+	convert(out, topology, normals);
+	out.write(schema);
+}
 
-		if (mesh.getNumTexCoords() == mesh.getNumVertices())
-		{
-			const std::vector<glm::vec2> &v = mesh.getTexCoords();
+void PolyMesh::convert(Output &out, bool topology, bool normals) const
+{
+	static_assert(sizeof(glm::vec3) == sizeof(V3f) && sizeof(glm::vec2) == sizeof(V2f), "vertex layouts differ");
 
-			uvs.resize(num_samples);
-			for (int i = 0; i < num_samples; i++)
-				uvs[i] = toAbc(v[idx[i]]);
-		}
-		assert(uvs.size() == 0 || uvs.size() == num_samples);
+	const std::vector<glm::vec3> &verts = mesh.getVertices();
+	const size_t num_points = verts.size();
 
-		if (mesh.getNumNormals() == mesh.getNumVertices())
-		{
-			const std::vector<glm::vec3> &v = mesh.getNormals();
+	// positions are written straight from the mesh, no copy
+	out.positions = verts.data();
+	out.num_points = num_points;
+	out.uvs = NULL;
+	out.topology = topology;
 
-			norms.resize(num_samples);
-			for (int i = 0; i < num_samples; i++)
-				norms[i] = toAbc(glm::normalize(v[idx[i]]) * -1);
-		}
-		assert(norms.size() == 0 || norms.size() == num_samples);
-	}
-	else
+	out.indexes.clear();
+	out.counts.clear();
+	out.norms.clear();
+
+	if (topology)
 	{
-		const int num_samples = mesh.getNumVertices();
+		vector<int32_t> &indexes = out.indexes;
 
+		// faces index into the vertices, a mesh without indices uses them in order
+		if (mesh.getNumIndices())
 		{
-			indexes.resize(num_samples);
-			for (int i = 0; i < num_samples; i++)
-				indexes[i] = i;
+			const vector<ofIndexType> &idx = mesh.getIndices();
+			indexes.assign(idx.begin(), idx.end());
 		}
-
+		else
 		{
-			const std::vector<glm::vec3>& verts = mesh.getVertices();
-			positions.resize(num_samples);
-
-			for (int i = 0; i < num_samples; i++)
-				positions[i] = toAbc(verts[i]);
+			indexes.resize(num_points);
+			for (size_t i = 0; i < num_points; i++)
+				indexes[i] = i;
 		}
 
-		if (mesh.getNumTexCoords() == num_samples)
+		if (!face_counts.empty())
 		{
-			const std::vector<glm::vec2> &v = mesh.getTexCoords();
+			size_t num_corners = 0;
+			for (size_t i = 0; i < face_counts.size(); i++)
+				num_corners += face_counts[i];
 
-			uvs.resize(num_samples);
-			for (int i = 0; i < num_samples; i++)
-				uvs[i] = toAbc(v[i]);
+			// a dropped sample would move every later one a frame back
+			if (num_corners == indexes.size())
+				out.counts = face_counts;
+			else
+				ofLogError("ofxAlembic::PolyMesh") << "face counts cover " << num_corners << " corners, mesh has " << indexes.size() << ", written as triangles";
 		}
-		assert(uvs.size() == 0 || uvs.size() == num_samples);
 
-		if (mesh.getNumNormals() == num_samples)
+		if (out.counts.empty())
 		{
-			const std::vector<glm::vec3> &v = mesh.getNormals();
-			norms.resize(num_samples);
-			for (int i = 0; i < num_samples; i++)
-				norms[i] = toAbc(glm::normalize(v[i]) * -1);
+			out.counts.assign(indexes.size() / 3, 3);
+			indexes.resize(out.counts.size() * 3);
 		}
-		assert(norms.size() == 0 || norms.size() == num_samples);
+
+		// per point values, readers tell them from face varying ones by size
+		if (mesh.getNumTexCoords() == num_points)
+			out.uvs = mesh.getTexCoords().data();
 	}
 
-	// supports only triangles
+	if (normals && mesh.getNumNormals() == num_points)
 	{
-		int num_tris = indexes.size() / 3;
-		counts.resize(num_tris);
-		for (int i = 0; i < num_tris; i++)
-			counts[i] = 3;
+		const std::vector<glm::vec3> &v = mesh.getNormals();
+
+		out.norms.resize(num_points);
+		for (size_t i = 0; i < num_points; i++)
+			out.norms[i] = toAbc(glm::normalize(v[i]) * -1);
 	}
+}
+
+void PolyMesh::Output::write(OPolyMeshSchema &schema)
+{
+	OPolyMeshSchema::Sample sample(P3fArraySample((const V3f*)positions, num_points));
 
-	if (!uvs.empty())
+	OV2fGeomParam::Sample uv_sample;
+	ON3fGeomParam::Sample norm_sample;
+
+	if (topology)
 	{
-		uv_sample.setScope(kVertexScope);
-		uv_sample.setVals(V2fArraySample(uvs));
+		sample.setFaceIndices(Int32ArraySample(indexes));
+		sample.setFaceCounts(Int32ArraySample(counts));
+
+		if (uvs)
+		{
+			uv_sample.setScope(kVertexScope);
+			uv_sample.setVals(V2fArraySample((const V2f*)uvs, num_points));
+			sample.setUVs(uv_sample);
+		}
 	}
 
 	if (!norms.empty())
 	{
 		norm_sample.setScope(kVertexScope);
 		norm_sample.setVals(N3fArraySample(norms));
+		sample.setNormals(norm_sample);
 	}
 
-	OPolyMeshSchema::Sample sample((P3fArraySample(positions)),
-								   Int32ArraySample(indexes),
-								   Int32ArraySample(counts),
-								   uv_sample,
-								   norm_sample);
 	schema.set(sample);
 }
 
 void PolyMesh::set(IPolyMeshSchema &schema, float time)
 {
-	ISampleSelector ss(time, ISampleSelector::kNearIndex);
-	IPolyMeshSchema::Sample sample;
-	schema.get(sample, ss);
+	set(schema, ISampleSelector(time, ISampleSelector::kNearIndex));
+}
 
-	P3fArraySamplePtr m_meshP = sample.getPositions();
-	Int32ArraySamplePtr m_meshIndices = sample.getFaceIndices();
-	Int32ArraySamplePtr m_meshCounts = sample.getFaceCounts();
+void PolyMesh::set(IPolyMeshSchema &schema, const ISampleSelector &ss)
+{
+	set(schema, ss, MeshTopology());
+}
 
-	mesh.clear();
+void PolyMesh::set(IPolyMeshSchema &schema, const ISampleSelector &ss, const MeshTopology &topology, ThreadPool *pool)
+{
+	if (topology.empty())
+	{
+		IPolyMeshSchema::Sample sample;
+		schema.get(sample, ss);
 
-	size_t numFaces = m_meshCounts->size();
-    size_t numIndices = m_meshIndices->size();
-	size_t numPoints = m_meshP->size();
-	if (numFaces < 1 ||
-		numIndices < 1 ||
-		numPoints < 1)
+		mesh.clear();
+
+		MeshTopology local;
+		local.indexed = topology.indexed;
+		if (!local.build(sample.getPositions()->size(), sample.getFaceIndices(), sample.getFaceCounts(), pool))
+			return;
+
+		if (local.indexed)
+			local.weld(schema, ss);
+
+		update(schema, ss, sample.getPositions(), local, true, pool);
+		return;
+	}
+
+	// homogeneous topology, only the positions are read
+	P3fArraySamplePtr m_meshP = schema.getPositionsProperty().getValue(ss);
+
+	if (m_meshP->size() != topology.num_points)
 	{
+		ofLogError("ofxAlembic::PolyMesh") << "point count changed on a homogeneous mesh";
+		MeshTopology local;
+		local.indexed = topology.indexed;
+		set(schema, ss, local, pool);
 		return;
 	}
 
-	// TODO: organaize face index
-	// make Triangle and Quad class
+	update(schema, ss, m_meshP, topology, false, pool);
+}
+
+bool PolyMesh::evaluate(IPolyMeshSchema &schema, const ISampleSelector &ss, const MeshTopology &topology, glm::vec3* positions, glm::vec3* normals, ThreadPool *pool)
+{
+	IN3fGeomParam N = schema.getNormalsParam();
+	if (normals && (!N.valid() || N.isIndexed()))
+	{
+		// the caller's normals would be left as they are
+		ofLogError("ofxAlembic::PolyMesh") << (N.valid() ? "indexed normal is not supported" : "no normals to evaluate");
+		return false;
+	}
+
+	P3fArraySamplePtr P = schema.getPositionsProperty().getValue(ss);
+	if (P->size() != topology.num_points) return false;
+
+	const vector<uint32_t> &vertex_points = topology.indexed ? topology.vertex_points : topology.points;
+	const vector<uint32_t> &vertex_corners = topology.indexed ? topology.vertex_corners : topology.corners;
+	const size_t num_vertices = vertex_points.size();
+
+	for_ranges(pool, num_vertices, [&](size_t b, size_t e)
+	{
+		gatherV3f(&positions[b].x, &P->get()->x, P->size(), vertex_points.data() + b, e - b);
+	});
+
+	if (normals)
+	{
+		N3fArraySamplePtr norm_ptr = N.getExpandedValue(ss).getVals();
+
+		const bool per_point = is_per_point(N.getScope());
+		const uint32_t* remap = per_point ? vertex_points.data() : vertex_corners.data();
+
+		for_ranges(pool, num_vertices, [&](size_t b, size_t e)
+		{
+			gatherV3f(&normals[b].x, &norm_ptr->get()->x, norm_ptr->size(), remap + b, e - b);
+		});
+	}
+
+	return true;
+}
+
+void PolyMesh::update(IPolyMeshSchema &schema, const ISampleSelector &ss, P3fArraySamplePtr m_meshP, const MeshTopology &topology, bool topology_changed, ThreadPool *pool)
+{
+	// indexed layout has one vertex per distinct (point, normal, uv), otherwise one per triangle corner
+	const vector<uint32_t> &vertex_points = topology.indexed ? topology.vertex_points : topology.points;
+	const vector<uint32_t> &vertex_corners = topology.indexed ? topology.vertex_corners : topology.corners;
+	const size_t num_vertices = vertex_points.size();
+
+	{
+		std::vector<glm::vec3>& dst = mesh.getVertices();
+		dst.resize(num_vertices);
+		
+		for_ranges(pool, num_vertices, [&](size_t b, size_t e)
+		{
+			gatherV3f(&dst[b].x, &m_meshP->get()->x, m_meshP->size(), vertex_points.data() + b, e - b);
+		});
+	}
+
+	{
+		IN3fGeomParam N = schema.getNormalsParam();
+		std::vector<glm::vec3>& dst = mesh.getNormals();
+		
+		if (!N.valid())
+		{
+			dst.clear();
+		}
+		else if (N.isIndexed())
+		{
+			// stale normals may be sized for another topology
+			ofLogError("ofxAlembic::PolyMesh") << "indexed normal is not supported";
+			dst.clear();
+		}
+		else if (!N.isConstant() || dst.size() != num_vertices || topology_changed)
+		{
+			N3fArraySamplePtr norm_ptr = N.getExpandedValue(ss).getVals();
+			const N3f* src = norm_ptr->get();
+			
+			// per point normals follow P, face varying ones follow the corners
+			const bool per_point = is_per_point(N.getScope());
+			const uint32_t* remap = per_point ? vertex_points.data() : vertex_corners.data();
+			dst.resize(num_vertices);
+			
+			for_ranges(pool, num_vertices, [&](size_t b, size_t e)
+			{
+				gatherV3f(&dst[b].x, &src->x, norm_ptr->size(), remap + b, e - b);
+			});
+		}
+	}
+
+	{
+		IV2fGeomParam UV = schema.getUVsParam();
+		std::vector<glm::vec2>& dst = mesh.getTexCoords();
+		
+		if (!UV.valid())
+		{
+			dst.clear();
+		}
+		else if (!UV.isConstant() || dst.size() != num_vertices || topology_changed)
+		{
+			dst.resize(num_vertices);
+			
+			if (UV.isIndexed())
+			{
+				auto value = UV.getIndexedValue(ss);
+				V2fArraySamplePtr uv_ptr = value.getVals();
+				const V2f* src = uv_ptr->get();
+				auto indices = value.getIndices()->get();
+				
+				const bool per_point = is_per_point(UV.getScope());
+				const uint32_t* remap = per_point ? vertex_points.data() : vertex_corners.data();
+				
+				for_ranges(pool, num_vertices, [&](size_t b, size_t e)
+				{
+					gatherV2f(&dst[b].x, &src->x, uv_ptr->size(), remap + b, e - b, indices);
+				});
+			}
+			else
+			{
+				V2fArraySamplePtr uv_ptr = UV.getExpandedValue(ss).getVals();
+				const V2f* src = uv_ptr->get();
+				
+				const bool per_point = is_per_point(UV.getScope());
+				const uint32_t* remap = per_point ? vertex_points.data() : vertex_corners.data();
+				
+				for_ranges(pool, num_vertices, [&](size_t b, size_t e)
+				{
+					gatherV2f(&dst[b].x, &src->x, uv_ptr->size(), remap + b, e - b);
+				});
+			}
+		}
+	}
+
+	{
+		std::vector<ofIndexType>& dst = mesh.getIndices();
+		
+		if (!topology.indexed)
+			dst.clear();
+		else if (topology_changed || dst.size() != topology.indices.size())
+			dst.assign(topology.indices.begin(), topology.indices.end());
+	}
+}
+
+void PolyMesh::swap(PolyMesh &other)
+{
+	face_counts.swap(other.face_counts);
+	mesh.getVertices().swap(other.mesh.getVertices());
+	mesh.getNormals().swap(other.mesh.getNormals());
+	mesh.getTexCoords().swap(other.mesh.getTexCoords());
+	mesh.getColors().swap(other.mesh.getColors());
+	mesh.getIndices().swap(other.mesh.getIndices());
+
+	ofPrimitiveMode mode = mesh.getMode();
+	mesh.setMode(other.mesh.getMode());
+	other.mesh.setMode(mode);
+}
+
+size_t PolyMesh::getMemoryUsage() const
+{
+	return mesh.getVertices().capacity() * sizeof(glm::vec3)
+		+ mesh.getNormals().capacity() * sizeof(glm::vec3)
+		+ mesh.getTexCoords().capacity() * sizeof(glm::vec2)
+		+ mesh.getColors().capacity() * sizeof(ofFloatColor)
+		+ mesh.getIndices().capacity() * sizeof(ofIndexType)
+		+ face_counts.capacity() * sizeof(int32_t);
+}
+
+void PolyMesh::draw() const
+{
+	if (ofGetStyle().bFill)
+	{
+		mesh.draw();
+	}
+	else
+	{
+		mesh.drawWireframe();
+	}
+}
+
+#pragma mark - MeshTopology
 
-	typedef Imath::Vec3<unsigned int> Tri;
-	typedef std::vector<Tri> TriArray;
+bool MeshTopology::build(size_t num_points, const Int32ArraySamplePtr& face_indices, const Int32ArraySamplePtr& face_counts)
+{
+	corners.clear();
+	points.clear();
+	vertex_points.clear();
+	vertex_corners.clear();
+	indices.clear();
+
+	size_t numFaces = face_counts->size();
+	size_t numIndices = face_indices->size();
+	if (numFaces < 1 ||
+		numIndices < 1 ||
+		num_points < 1)
+	{
+		return false;
+	}
 
-	TriArray m_triangles;
+	this->num_points = num_points;
+	this->num_indices = numIndices;
 
+	// fan triangulation, three corners per triangle
 	size_t faceIndexBegin = 0;
 	size_t faceIndexEnd = 0;
 	for (size_t face = 0; face < numFaces; ++face)
 	{
 		faceIndexBegin = faceIndexEnd;
-		size_t count = (*m_meshCounts)[face];
+		size_t count = (*face_counts)[face];
 		faceIndexEnd = faceIndexBegin + count;
 
 		// Check this face is valid
@@ -336,142 +602,188 @@ void PolyMesh::set(IPolyMeshSchema &schema, float time)
 		}
 
 		// Make triangles to fill this face.
-		if (count >= 3)
+		for (size_t c = 2; c < count; ++c)
 		{
-			m_triangles.push_back(Tri((unsigned int)faceIndexBegin + 0,
-									  (unsigned int)faceIndexBegin + 1,
-									  (unsigned int)faceIndexBegin + 2));
-			for (size_t c = 3; c < count; ++c)
-			{
-				m_triangles.push_back(Tri((unsigned int)faceIndexBegin + 0,
-										  (unsigned int)faceIndexBegin + c - 1,
-										  (unsigned int)faceIndexBegin + c));
-			}
+			corners.push_back((uint32_t)faceIndexBegin + 0);
+			corners.push_back((uint32_t)(faceIndexBegin + c - 1));
+			corners.push_back((uint32_t)(faceIndexBegin + c));
 		}
 	}
 
+	const int32_t* face_index = face_indices->get();
+	points.resize(corners.size());
+	for (size_t i = 0; i < corners.size(); i++)
+		points[i] = face_index[corners[i]];
+
+	return !corners.empty();
+}
+
+bool MeshTopology::build(size_t num_points, const Int32ArraySamplePtr& face_indices, const Int32ArraySamplePtr& face_counts, ThreadPool *pool)
+{
+	const size_t numFaces = face_counts->size();
+	const size_t numIndices = face_indices->size();
+
+	if (pool == NULL
+		|| numFaces < PolyMesh::getParallelThreshold()
+		|| num_points < 1
+		|| numIndices < 1)
 	{
-		const V3f* points = m_meshP->get();
-		const int32_t* indices = m_meshIndices->get();
-		std::vector<glm::vec3>& dst = mesh.getVertices();
-		dst.resize(m_triangles.size() * 3);
-		
-		glm::vec3* dst_ptr = dst.data();
-        
-		for (int i = 0; i < m_triangles.size(); i++)
-		{
-			Tri &t = m_triangles[i];
-			
-			const V3f& v0 = points[indices[t[0]]];
-			memcpy(dst_ptr++, &v0.x, sizeof(float) * 3);
-			
-			const V3f& v1 = points[indices[t[1]]];
-			memcpy(dst_ptr++, &v1.x, sizeof(float) * 3);
-			
-			const V3f& v2 = points[indices[t[2]]];
-			memcpy(dst_ptr++, &v2.x, sizeof(float) * 3);
-		}
+		return build(num_points, face_indices, face_counts);
 	}
 
+	corners.clear();
+	points.clear();
+	vertex_points.clear();
+	vertex_corners.clear();
+	indices.clear();
+
+	// first pass sums face vertices and triangles per chunk, a scan over the
+	// chunks gives every chunk its output offset so the layout matches the serial one
+	const size_t num_chunks = pool->getNumThreads() * 4;
+	const int32_t* counts = face_counts->get();
+
+	vector<size_t> chunk_indices(num_chunks + 1, 0);
+	vector<size_t> chunk_tris(num_chunks + 1, 0);
+	std::atomic<bool> valid(true);
+
+	pool->parallelFor(0, num_chunks, [&](size_t c)
 	{
-		IN3fGeomParam N = schema.getNormalsParam();
-		if (N.valid())
+		size_t sum_indices = 0, sum_tris = 0;
+		for (size_t face = numFaces * c / num_chunks; face < numFaces * (c + 1) / num_chunks; face++)
 		{
-			if (N.isIndexed())
-			{
-				ofLogError("ofxAlembic::PolyMesh") << "indexed normal is not supported";
-			}
-			else
-			{
-				N3fArraySamplePtr norm_ptr = N.getExpandedValue(ss).getVals();
-				const N3f* src = norm_ptr->get();
-				std::vector<glm::vec3>& dst = mesh.getNormals();
-				dst.resize(m_triangles.size() * 3);
-				
-				glm::vec3* dst_ptr = dst.data();
-
-				for (int i = 0; i < m_triangles.size(); i++)
-				{
-					Tri &t = m_triangles[i];
-					
-					const N3f& n0 = src[t[0]];
-					memcpy(dst_ptr++, &n0.x, sizeof(float) * 3);
-					
-					const N3f& n1 = src[t[1]];
-					memcpy(dst_ptr++, &n1.x, sizeof(float) * 3);
-					
-					const N3f& n2 = src[t[2]];
-					memcpy(dst_ptr++, &n2.x, sizeof(float) * 3);
-				}
-			}
+			if (counts[face] < 0) valid = false;
+			sum_indices += counts[face];
+			sum_tris += counts[face] > 2 ? counts[face] - 2 : 0;
 		}
+		chunk_indices[c + 1] = sum_indices;
+		chunk_tris[c + 1] = sum_tris;
+	});
+
+	for (size_t c = 0; c < num_chunks; c++)
+	{
+		chunk_indices[c + 1] += chunk_indices[c];
+		chunk_tris[c + 1] += chunk_tris[c];
 	}
 
+	// let the serial path report and truncate wonky meshes
+	if (!valid || chunk_indices[num_chunks] > numIndices)
+		return build(num_points, face_indices, face_counts);
+
+	this->num_points = num_points;
+	this->num_indices = numIndices;
+
+	corners.resize(chunk_tris[num_chunks] * 3);
+	points.resize(corners.size());
+
+	const int32_t* face_index = face_indices->get();
+
+	pool->parallelFor(0, num_chunks, [&](size_t c)
 	{
-        IV2fGeomParam UV = schema.getUVsParam();
-		if (UV.valid())
+		size_t faceIndexBegin = chunk_indices[c];
+		uint32_t *dst = corners.data() + chunk_tris[c] * 3;
+		uint32_t *dst_points = points.data() + chunk_tris[c] * 3;
+
+		for (size_t face = numFaces * c / num_chunks; face < numFaces * (c + 1) / num_chunks; face++)
 		{
-			if (UV.isIndexed())
+			const size_t count = counts[face];
+			for (size_t k = 2; k < count; ++k)
 			{
-                auto value = UV.getIndexedValue(ss);
-                V2fArraySamplePtr uv_ptr = value.getVals();
-                const V2f* src = uv_ptr->get();
-                auto indices = value.getIndices()->get();
-				std::vector<glm::vec2>& dst = mesh.getTexCoords();
-                dst.resize(m_triangles.size() * 3);
-                
-                glm::vec2* dst_ptr = dst.data();
-                
-                for (int i = 0; i < m_triangles.size(); i++)
-                {
-                    Tri &t = m_triangles[i];
-                    
-                    const V2f& t0 = src[indices[t[0]]];
-                    memcpy(dst_ptr++, &t0.x, sizeof(float) * 2);
-                    
-                    const V2f& t1 = src[indices[t[1]]];
-                    memcpy(dst_ptr++, &t1.x, sizeof(float) * 2);
-                    
-                    const V2f& t2 = src[indices[t[2]]];
-                    memcpy(dst_ptr++, &t2.x, sizeof(float) * 2);
-                }
-			}
-			else
-			{
-				V2fArraySamplePtr uv_ptr = UV.getExpandedValue(ss).getVals();
-				const V2f* src = uv_ptr->get();
-				std::vector<glm::vec2>& dst = mesh.getTexCoords();
-				dst.resize(m_triangles.size() * 3);
-				
-				glm::vec2* dst_ptr = dst.data();
+				*dst++ = (uint32_t)faceIndexBegin + 0;
+				*dst++ = (uint32_t)(faceIndexBegin + k - 1);
+				*dst++ = (uint32_t)(faceIndexBegin + k);
 
-				for (int i = 0; i < m_triangles.size(); i++)
-				{
-					Tri &t = m_triangles[i];
-					
-					const V2f& t0 = src[t[0]];
-					memcpy(dst_ptr++, &t0.x, sizeof(float) * 2);
-					
-					const V2f& t1 = src[t[1]];
-					memcpy(dst_ptr++, &t1.x, sizeof(float) * 2);
-					
-					const V2f& t2 = src[t[2]];
-					memcpy(dst_ptr++, &t2.x, sizeof(float) * 2);
-				}
+				*dst_points++ = face_index[faceIndexBegin + 0];
+				*dst_points++ = face_index[faceIndexBegin + k - 1];
+				*dst_points++ = face_index[faceIndexBegin + k];
 			}
+			faceIndexBegin += count;
 		}
-	}
+	});
+
+	return !corners.empty();
 }
 
-void PolyMesh::draw()
+void MeshTopology::weld(IPolyMeshSchema &schema, const ISampleSelector &ss)
 {
-	if (ofGetStyle().bFill)
+	// face varying attributes decide whether corners sharing a point can share a vertex
+	N3fArraySamplePtr normals;
+	V2fArraySamplePtr uvs;
+	UInt32ArraySamplePtr uv_indices;
+
+	// animated face varying values that match in this sample can diverge later,
+	// then only triangles of the same face corner share a vertex
+	bool split = false;
+
+	IN3fGeomParam N = schema.getNormalsParam();
+	if (N.valid() && !N.isIndexed() && !is_per_point(N.getScope()))
 	{
-		mesh.draw();
+		if (!N.isConstant())
+		{
+			split = true;
+		}
+		else
+		{
+			normals = N.getExpandedValue(ss).getVals();
+			if (normals->size() != num_indices) normals.reset();
+		}
 	}
-	else
+
+	IV2fGeomParam UV = schema.getUVsParam();
+	if (UV.valid() && !is_per_point(UV.getScope()))
 	{
-		mesh.drawWireframe();
+		if (!UV.isConstant())
+		{
+			split = true;
+		}
+		else if (UV.isIndexed())
+		{
+			uv_indices = UV.getIndexedValue(ss).getIndices();
+			if (uv_indices->size() != num_indices) uv_indices.reset();
+		}
+		else
+		{
+			uvs = UV.getExpandedValue(ss).getVals();
+			if (uvs->size() != num_indices) uvs.reset();
+		}
+	}
+
+	vertex_points.clear();
+	vertex_corners.clear();
+	indices.clear();
+	indices.reserve(corners.size());
+
+	// chain of output vertices already created for each point
+	vector<int32_t> first(num_points, -1);
+	vector<int32_t> next;
+
+	for (size_t i = 0; i < corners.size(); i++)
+	{
+		const uint32_t p = points[i];
+		const uint32_t c = corners[i];
+
+		int32_t v = first[p];
+		while (v >= 0)
+		{
+			const uint32_t o = vertex_corners[v];
+			if ((!split || o == c)
+				&& (!normals || (*normals)[o] == (*normals)[c])
+				&& (!uvs || (*uvs)[o] == (*uvs)[c])
+				&& (!uv_indices || (*uv_indices)[o] == (*uv_indices)[c]))
+				break;
+
+			v = next[v];
+		}
+
+		if (v < 0)
+		{
+			v = vertex_points.size();
+			vertex_points.push_back(p);
+			vertex_corners.push_back(c);
+			next.push_back(first[p]);
+			first[p] = v;
+		}
+
+		indices.push_back(v);
 	}
 }
 
@@ -479,8 +791,18 @@ void PolyMesh::draw()
 
 void Curves::get(OCurvesSchema &schema) const
 {
-	vector<V3f> positions;
-	vector<int32_t> num_vertices;
+	Output out;
+	convert(out);
+	out.write(schema);
+}
+
+void Curves::convert(Output &out) const
+{
+	vector<V3f> &positions = out.positions;
+	vector<int32_t> &num_vertices = out.num_vertices;
+
+	positions.clear();
+	num_vertices.clear();
 
 	for (int n = 0; n < curves.size(); n++)
 	{
@@ -493,7 +815,10 @@ void Curves::get(OCurvesSchema &schema) const
 
 		num_vertices.push_back(polyline.size());
 	}
+}
 
+void Curves::Output::write(OCurvesSchema &schema)
+{
 	OCurvesSchema::Sample sample((P3fArraySample(positions)),
 								 Int32ArraySample(num_vertices),
 								 kLinear,
@@ -503,7 +828,11 @@ void Curves::get(OCurvesSchema &schema) const
 
 void Curves::set(ICurvesSchema &schema, float time)
 {
-	ISampleSelector ss(time, ISampleSelector::kNearIndex);
+	set(schema, ISampleSelector(time, ISampleSelector::kNearIndex));
+}
+
+void Curves::set(ICurvesSchema &schema, const ISampleSelector &ss)
+{
 	ICurvesSchema::Sample sample;
 	schema.get(sample, ss);
 
@@ -532,7 +861,15 @@ void Curves::set(ICurvesSchema &schema, float time)
 	}
 }
 
-void Curves::draw()
+size_t Curves::getMemoryUsage() const
+{
+	size_t bytes = curves.capacity() * sizeof(ofPolyline);
+	for (int i = 0; i < curves.size(); i++)
+		bytes += curves[i].getVertices().capacity() * sizeof(glm::vec3);
+	return bytes;
+}
+
+void Curves::draw() const
 {
 	for (int i = 0; i < curves.size(); i++)
 	{
@@ -545,16 +882,26 @@ void Curves::draw()
 
 void Camera::get(OCameraSchema &schema) const
 {
-	Alembic::AbcGeom::CameraSample sample;
-	sample.setHorizontalAperture(this->sample.getHorizontalAperture());
-	sample.setVerticalAperture(this->sample.getVerticalAperture());
-	sample.setFocalLength(this->sample.getFocalLength());
-	schema.set(sample);
+	Output out;
+	convert(out);
+	out.write(schema);
+}
+
+void Camera::convert(Output &out) const
+{
+	out.sample = Alembic::AbcGeom::CameraSample();
+	out.sample.setHorizontalAperture(sample.getHorizontalAperture());
+	out.sample.setVerticalAperture(sample.getVerticalAperture());
+	out.sample.setFocalLength(sample.getFocalLength());
 }
 
 void Camera::set(ICameraSchema &schema, float time)
 {
-	ISampleSelector ss(time, ISampleSelector::kNearIndex);
+	set(schema, ISampleSelector(time, ISampleSelector::kNearIndex));
+}
+
+void Camera::set(ICameraSchema &schema, const ISampleSelector &ss)
+{
 	schema.get(sample, ss);
 }
 
@@ -575,7 +922,7 @@ void Camera::updateSample(const ofCamera &camera)
 	sample.setFocalLength(focalMm);
 }
 
-void Camera::updateParams(ofCamera &camera, ofMatrix4x4 xform)
+void Camera::updateParams(ofCamera &camera, ofMatrix4x4 xform) const
 {
 	float w, h;
 	if (width == 0 || height == 0)
@@ -598,6 +945,6 @@ void Camera::updateParams(ofCamera &camera, ofMatrix4x4 xform)
 	// TODO: lens offset
 }
 
-void Camera::draw()
+void Camera::draw() const
 {
 }
\ No newline at end of file
@@ -11,6 +11,8 @@
 namespace ofxAlembic
 {
 class PolyMesh;
+class MeshTopology;
+class ThreadPool;
 class Points;
 class Curves;
 class Camera;
@@ -18,6 +20,9 @@ class XForm;
 
 struct Point;
 
+template <typename T>
+class View;
+
 enum Type
 {
 	POINTS = 0,
@@ -39,8 +44,77 @@ public:
 	
 	void draw();
 	
+	// get() in two steps for writers that convert on other threads, the output
+	// owns everything until it is written
+	struct Output
+	{
+		Alembic::AbcGeom::XformSample sample;
+		void write(Alembic::AbcGeom::OXformSchema &schema) { schema.set(sample); }
+	};
+	
+	void convert(Output &out) const;
 	void get(Alembic::AbcGeom::OXformSchema &schema) const;
 	void set(Alembic::AbcGeom::IXformSchema &schema, float time);
+	void set(Alembic::AbcGeom::IXformSchema &schema, const Alembic::AbcGeom::ISampleSelector &ss);
+};
+
+// read-only strided view into data owned by the reader, valid until the next setTime
+
+template <typename T>
+class ofxAlembic::View
+{
+public:
+
+	View() : ptr(NULL), num(0), stride(sizeof(T)) {}
+	View(const T* data, size_t num, size_t stride = sizeof(T)) : ptr((const char*)data), num(num), stride(stride) {}
+	View(const vector<T>& v) : ptr((const char*)v.data()), num(v.size()), stride(sizeof(T)) {}
+
+	inline size_t size() const { return num; }
+	inline bool empty() const { return num == 0; }
+
+	// data() is only meaningful as an array when the view is contiguous
+	inline bool isContiguous() const { return stride == sizeof(T); }
+	inline const T* data() const { return (const T*)ptr; }
+	inline size_t getStride() const { return stride; }
+
+	inline const T& operator[](size_t i) const { return *(const T*)(ptr + i * stride); }
+
+protected:
+
+	const char *ptr;
+	size_t num;
+	size_t stride;
+};
+
+// fan triangulation of a polymesh, reusable across samples when the topology is homogeneous
+
+class ofxAlembic::MeshTopology
+{
+public:
+	size_t num_points;
+	size_t num_indices;
+
+	// per triangle corner, index into face varying values and into P
+	vector<uint32_t> corners;
+	vector<uint32_t> points;
+
+	// indexed output: P stays the vertex array, split only where normals/uvs differ
+	bool indexed;
+	vector<uint32_t> vertex_points;
+	vector<uint32_t> vertex_corners;
+	vector<ofIndexType> indices;
+
+	MeshTopology() : num_points(0), num_indices(0), indexed(false) {}
+
+	bool build(size_t num_points, const Alembic::AbcGeom::Int32ArraySamplePtr &face_indices, const Alembic::AbcGeom::Int32ArraySamplePtr &face_counts);
+	// splits the triangulation over pool for meshes above PolyMesh::getParallelThreshold()
+	bool build(size_t num_points, const Alembic::AbcGeom::Int32ArraySamplePtr &face_indices, const Alembic::AbcGeom::Int32ArraySamplePtr &face_counts, ThreadPool *pool);
+	// merges corners of a point with equal face varying normals/uvs, animated ones keep corners apart
+	void weld(Alembic::AbcGeom::IPolyMeshSchema &schema, const Alembic::AbcGeom::ISampleSelector &ss);
+	inline bool empty() const { return corners.empty(); }
+
+	// vertices of the output mesh, one per corner or one per welded vertex
+	inline size_t getNumVertices() const { return indexed ? vertex_points.size() : points.size(); }
 };
 
 class ofxAlembic::PolyMesh
@@ -48,13 +122,61 @@ class ofxAlembic::PolyMesh
 public:
 	ofMesh mesh;
 
+	// corners per face for writing quads and n-gons, over the mesh indices or over the
+	// vertices in order when there are none. empty, or counts that don't add up to the
+	// corners (logged), write triangles
+	vector<int32_t> face_counts;
+
 	PolyMesh() {}
 	PolyMesh(const ofMesh& mesh) : mesh(mesh) {}
+	PolyMesh(const ofMesh& mesh, const vector<int32_t>& face_counts) : mesh(mesh), face_counts(face_counts) {}
+
+	// positions and uvs point into the mesh, it has to outlive the output
+	struct Output
+	{
+		const glm::vec3 *positions;
+		const glm::vec2 *uvs;
+		size_t num_points;
+
+		vector<int32_t> indexes;
+		vector<int32_t> counts;
+		vector<Alembic::AbcGeom::N3f> norms;
+
+		bool topology;
+
+		Output() : positions(NULL), uvs(NULL), num_points(0), topology(false) {}
+		void write(Alembic::AbcGeom::OPolyMeshSchema &schema);
+	};
 
+	// writes the vertices as P with the real face indices, normals and uvs per point.
+	// later samples can leave out the topology (indices, counts, uvs) and the normals,
+	// the archive repeats the previous ones
+	void convert(Output &out, bool topology = true, bool normals = true) const;
 	void get(Alembic::AbcGeom::OPolyMeshSchema &schema) const;
+	void get(Alembic::AbcGeom::OPolyMeshSchema &schema, bool topology, bool normals) const;
 	void set(Alembic::AbcGeom::IPolyMeshSchema &schema, float time);
+	void set(Alembic::AbcGeom::IPolyMeshSchema &schema, const Alembic::AbcGeom::ISampleSelector &ss);
+	// reads only P (and animated N/UV) and scatters it through a prebuilt topology
+	void set(Alembic::AbcGeom::IPolyMeshSchema &schema, const Alembic::AbcGeom::ISampleSelector &ss, const MeshTopology &topology, ThreadPool *pool = NULL);
 
-	void draw();
+	// positions and normals of one sample in the vertex layout of a prebuilt topology, written
+	// to caller storage of topology.getNumVertices() elements each. normals stay untouched
+	// when the mesh has none, false when the point count doesn't match the topology
+	static bool evaluate(Alembic::AbcGeom::IPolyMeshSchema &schema, const Alembic::AbcGeom::ISampleSelector &ss, const MeshTopology &topology, glm::vec3* positions, glm::vec3* normals, ThreadPool *pool = NULL);
+
+	// meshes with at least this many faces/vertices are split over the pool passed to set()
+	static void setParallelThreshold(size_t num);
+	static size_t getParallelThreshold();
+
+	// exchanges the vertex buffers without copying
+	void swap(PolyMesh &other);
+	size_t getMemoryUsage() const;
+
+	void draw() const;
+
+protected:
+
+	void update(Alembic::AbcGeom::IPolyMeshSchema &schema, const Alembic::AbcGeom::ISampleSelector &ss, Alembic::AbcGeom::P3fArraySamplePtr positions, const MeshTopology &topology, bool topology_changed, ThreadPool *pool);
 };
 
 struct ofxAlembic::Point
@@ -79,10 +201,22 @@ public:
 	Points(const vector<glm::vec3>& points);
 	Points(const vector<Point>& points) : points(points) {}
 
+	struct Output
+	{
+		vector<Alembic::AbcGeom::V3f> positions;
+		vector<uint64_t> ids;
+		void write(Alembic::AbcGeom::OPointsSchema &schema);
+	};
+
+	void convert(Output &out) const;
 	void get(Alembic::AbcGeom::OPointsSchema &schema) const;
 	void set(Alembic::AbcGeom::IPointsSchema &schema, float time);
+	void set(Alembic::AbcGeom::IPointsSchema &schema, const Alembic::AbcGeom::ISampleSelector &ss);
 
-	void draw();
+	void swap(Points &other) { points.swap(other.points); }
+	size_t getMemoryUsage() const { return points.capacity() * sizeof(Point); }
+
+	void draw() const;
 };
 
 class ofxAlembic::Curves
@@ -93,10 +227,22 @@ public:
 	Curves() {}
 	Curves(const vector<ofPolyline> &curves) : curves(curves) {}
 
+	struct Output
+	{
+		vector<Alembic::AbcGeom::V3f> positions;
+		vector<int32_t> num_vertices;
+		void write(Alembic::AbcGeom::OCurvesSchema &schema);
+	};
+
+	void convert(Output &out) const;
 	void get(Alembic::AbcGeom::OCurvesSchema &schema) const;
 	void set(Alembic::AbcGeom::ICurvesSchema &schema, float time);
+	void set(Alembic::AbcGeom::ICurvesSchema &schema, const Alembic::AbcGeom::ISampleSelector &ss);
 
-	void draw();
+	void swap(Curves &other) { curves.swap(other.curves); }
+	size_t getMemoryUsage() const;
+
+	void draw() const;
 };
 
 class ofxAlembic::Camera
@@ -106,15 +252,27 @@ public:
 	Camera() : width(0), height(0) {}
 	Camera(const ofCamera& camera) : width(0), height(0) {}
 	
+	struct Output
+	{
+		Alembic::AbcGeom::CameraSample sample;
+		void write(Alembic::AbcGeom::OCameraSchema &schema) { schema.set(sample); }
+	};
+	
+	void convert(Output &out) const;
 	void get(Alembic::AbcGeom::OCameraSchema &schema) const;
 	void set(Alembic::AbcGeom::ICameraSchema &schema, float time);
+	void set(Alembic::AbcGeom::ICameraSchema &schema, const Alembic::AbcGeom::ISampleSelector &ss);
 	
 	void setViewport(int width, int height) { this->width = width, this->height = height; }
 	
-	void updateParams(ofCamera &camera, ofMatrix4x4 xform);
+	void updateParams(ofCamera &camera, ofMatrix4x4 xform) const;
 	void updateSample(const ofCamera &camera);
 	
-	void draw();
+	// the viewport is a display setting, only the sample moves between buffers
+	void swap(Camera &other) { std::swap(sample, other.sample); }
+	size_t getMemoryUsage() const { return sizeof(Camera); }
+	
+	void draw() const;
 	
 protected:
 	
@@ -14,6 +14,47 @@ void ofxAlembic::init()
 	H5dont_atexit();
 }
 
+std::recursive_mutex& ofxAlembic::getHDF5Mutex()
+{
+	static std::recursive_mutex mutex;
+	return mutex;
+}
+
+bool ofxAlembic::matchPattern(const string& pattern, const string& str)
+{
+	size_t p = 0, s = 0;
+	size_t star = string::npos, retry = 0;
+
+	while (s < str.size())
+	{
+		if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == str[s]))
+		{
+			p++;
+			s++;
+		}
+		else if (p < pattern.size() && pattern[p] == '*')
+		{
+			// remember the star and try to match nothing first
+			star = p++;
+			retry = s;
+		}
+		else if (star != string::npos)
+		{
+			p = star + 1;
+			s = ++retry;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	while (p < pattern.size() && pattern[p] == '*')
+		p++;
+
+	return p == pattern.size();
+}
+
 void ofxAlembic::transform(ofMesh &mesh, const glm::mat4 &m)
 {
 	std::vector<glm::vec3>& vertices = mesh.getVertices();
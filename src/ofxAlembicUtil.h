@@ -2,6 +2,8 @@
 
 #include "ofMain.h"
 
+#include <mutex>
+
 #include <Alembic/AbcGeom/All.h>
 #include <Alembic/AbcCoreHDF5/All.h>
 #include <Alembic/AbcCoreOgawa/All.h>
@@ -14,6 +16,12 @@ namespace ofxAlembic
 	
 	void init();
 	void transform(ofMesh &mesh, const glm::mat4 &m);
+
+	// HDF5 is not thread safe, every read from an HDF5 archive must hold this lock
+	std::recursive_mutex& getHDF5Mutex();
+
+	// glob match, '*' is any run of characters and '?' a single one
+	bool matchPattern(const string& pattern, const string& str);
 }
 
 inline ofVec3f toOf(const Alembic::AbcGeom::V3f& v)
@@ -3,9 +3,40 @@
 using namespace ofxAlembic;
 using namespace Alembic::AbcGeom;
 
+template <typename O>
+static OObject* make_object(OObject& parent, const string& name, uint32_t time_sampling)
+{
+	O *o = new O(parent, name);
+	o->getSchema().setTimeSampling(time_sampling);
+	return o;
+}
+
+Writer::Writer()
+	: generation(0)
+	, inv_fps(1. / 30)
+	, current_time(0)
+	, async(false)
+	, max_queue_size(64)
+	, queue_policy(QUEUE_BLOCK)
+	, running(false)
+	, writing(false)
+	, max_queue_depth(0)
+	, num_dropped(0)
+	, num_stalls(0)
+	, default_topology_mode(TOPOLOGY_VARYING)
+	, num_topology_skipped(0)
+	, num_failed(0)
+	, in_frame(false)
+{
+}
+
 bool Writer::open(const string& path, float fps, Alembic::AbcCoreFactory::IFactory::CoreType type)
 {
 	ofxAlembic::init();
+
+	// finishes the previous archive, its objects and time samplings don't carry over
+	close();
+
     if ( type == Alembic::AbcCoreFactory::IFactory::kOgawa) {
         archive = OArchive(Alembic::AbcCoreOgawa::WriteArchive(), ofToDataPath(path));
     } else if ( type == Alembic::AbcCoreFactory::IFactory::kHDF5 ) {
@@ -15,80 +46,181 @@ bool Writer::open(const string& path, float fps, Alembic::AbcCoreFactory::IFacto
 
 	archive.setCompressionHint(1);
 
+	// handles of the previous archive stay invalid
+	generation++;
+
 	inv_fps = 1. / fps;
 	rewind();
 
+	num_failed = 0;
+
 	return true;
 }
 
 void Writer::close()
 {
-	map<string, Alembic::AbcGeom::OObject*>::iterator it = object_map.begin();
-	while (it != object_map.end())
+	// queued samples still belong to this archive
+	endFrame();
+	stopThread();
+
+	for (size_t i = 0; i < declared.size(); i++)
 	{
-		delete it->second;
-		it++;
+		Node &node = *declared[i];
+		if (node.object == NULL) continue;
+
+		// parents that only ever got children
+		if (node.type == XFORM)
+		{
+			OXformSchema &schema = static_cast<OXform*>(node.object)->getSchema();
+			XformSample identity;
+			if (schema.getNumSamples() == 0)
+				schema.set(identity);
+		}
 	}
 
-	object_map.clear();
+	for (size_t i = 0; i < declared.size(); i++)
+	{
+		delete declared[i]->object;
+		declared[i]->object = NULL;
+	}
+
+	nodes.clear();
+	declared.clear();
+	time_samplings.clear();
 
 	if (archive.valid())
 		archive.reset();
 }
 
-void Writer::addPoints(const string& path, const Points& points)
+#pragma mark - objects
+
+ofPtr<Writer::Node> Writer::declare(const string& path, Type type)
 {
-	typedef OPoints Type;
-	typedef Type::schema_type Schema;
+	std::unordered_map<string, ofPtr<Node> >::iterator it = nodes.find(path);
+	if (it != nodes.end())
+	{
+		if (it->second->type == type) return it->second;
 
-	Type &object = getObject<Type>(path);
-	Schema &schema = object.getSchema();
+		ofLogError("ofxAlembic::Writer") << "object of another type: '" << path << "'";
+		return ofPtr<Node>();
+	}
 
-	points.get(schema);
+	if (!archive.valid())
+	{
+		ofLogError("ofxAlembic::Writer") << "archive not open: '" << path << "'";
+		return ofPtr<Node>();
+	}
+
+	if (path.size() < 2
+		|| path[0] != '/'
+		|| path[path.size() - 1] == '/'
+		|| path.find("//") != string::npos)
+	{
+		ofLogError("ofxAlembic::Writer") << "invalid path: '" << path << "'";
+		return ofPtr<Node>();
+	}
+
+	const size_t slash = path.rfind('/');
+
+	ofPtr<Node> parent;
+	if (slash > 0)
+	{
+		const string parent_path = path.substr(0, slash);
+
+		it = nodes.find(parent_path);
+		parent = it != nodes.end() ? it->second : declare(parent_path, XFORM);
+	}
+
+	ofPtr<Node> node(new Node());
+	node->name = path.substr(slash + 1);
+	node->parent = parent;
+	node->type = type;
+	node->generation = generation;
+
+	map<string, TopologyMode>::const_iterator mode = topology_modes.find(path);
+	if (mode != topology_modes.end())
+	{
+		node->has_topology_mode = true;
+		node->topology_mode = mode->second;
+	}
+
+	nodes[path] = node;
+	declared.push_back(node);
+
+	return node;
 }
 
-void Writer::addPolyMesh(const string& path, const PolyMesh& polymesh)
+OObject& Writer::construct(Node& node, float time)
 {
-	typedef OPolyMesh Type;
-	typedef Type::schema_type Schema;
+	if (node.object) return *node.object;
+
+	OObject parent = node.parent ? construct(*node.parent, time) : archive.getTop();
+	const uint32_t ts = getTimeSampling(time);
 
-	Type &object = getObject<Type>(path);
-	Schema &schema = object.getSchema();
+	switch (node.type)
+	{
+		case POINTS: node.object = make_object<OPoints>(parent, node.name, ts); break;
+		case CURVES: node.object = make_object<OCurves>(parent, node.name, ts); break;
+		case POLYMESH: node.object = make_object<OPolyMesh>(parent, node.name, ts); break;
+		case CAMERA: node.object = make_object<OCamera>(parent, node.name, ts); break;
+		default: node.object = make_object<OXform>(parent, node.name, ts); break;
+	}
 
-	polymesh.get(schema);
+	return *node.object;
 }
 
-void Writer::addCurves(const string& path, const Curves& curves)
+uint32_t Writer::getTimeSampling(float time)
+{
+	// objects created in the same frame share their time sampling
+	map<float, uint32_t>::iterator it = time_samplings.find(time);
+	if (it != time_samplings.end()) return it->second;
+
+	uint32_t index = archive.addTimeSampling(TimeSampling(inv_fps, time));
+	time_samplings[time] = index;
+
+	return index;
+}
+
+#pragma mark - add
+
+void Writer::addPoints(const string& path, const Points& points)
+{
+	submit(path, points);
+}
+
+void Writer::addPoints(const string& path, Points&& points)
+{
+	submit(path, std::move(points));
+}
+
+void Writer::addPolyMesh(const string& path, const PolyMesh& polymesh)
 {
-	typedef OCurves Type;
-	typedef Type::schema_type Schema;
+	submit(path, polymesh);
+}
 
-	Type &object = getObject<Type>(path);
-	Schema &schema = object.getSchema();
+void Writer::addPolyMesh(const string& path, PolyMesh&& polymesh)
+{
+	submit(path, std::move(polymesh));
+}
+
+void Writer::addCurves(const string& path, const Curves& curves)
+{
+	submit(path, curves);
+}
 
-	curves.get(schema);
+void Writer::addCurves(const string& path, Curves&& curves)
+{
+	submit(path, std::move(curves));
 }
 
 void Writer::addXform(const string& path, const XForm& xform)
 {
-	typedef OXform Type;
-	typedef Type::schema_type Schema;
-	
-	Type &object = getObject<Type>(path);
-	Schema &schema = object.getSchema();
-	
-	xform.get(schema);
+	submit(path, xform);
 }
 
 void Writer::addCamera(const string& path, const Camera& camera)
 {
-	typedef OCamera Type;
-	typedef Type::schema_type Schema;
-	
-	Type &object = getObject<Type>(path);
-	Schema &schema = object.getSchema();
-	
-	camera.get(schema);
+	submit(path, camera);
 }
 
 void Writer::addCamera(const string& path, const ofCamera& ofcamera)
@@ -100,6 +232,209 @@ void Writer::addCamera(const string& path, const ofCamera& ofcamera)
 	addCamera(path + "/cameraShape", camera);
 }
 
+void Writer::convert(Node& node, const PolyMesh& polymesh, PolyMesh::Output& out)
+{
+	const TopologyMode mode = node.has_topology_mode ? node.topology_mode : default_topology_mode;
+
+	if (mode == TOPOLOGY_VARYING)
+	{
+		polymesh.convert(out);
+		return;
+	}
+
+	const ofMesh &mesh = polymesh.mesh;
+	MeshState &state = node.mesh;
+
+	// a changed point count always means new topology
+	bool topology = !state.written || state.num_points != mesh.getNumVertices();
+
+	if (!topology && mode == TOPOLOGY_DETECT)
+	{
+		topology = state.indices != mesh.getIndices()
+			|| state.face_counts != polymesh.face_counts
+			|| state.uvs != mesh.getTexCoords();
+	}
+
+	// comparing is cheaper than converting and digesting them again
+	const bool normals = topology || state.normals != mesh.getNormals();
+
+	polymesh.convert(out, topology, normals);
+
+	if (topology)
+	{
+		state.written = true;
+		state.num_points = mesh.getNumVertices();
+
+		// homogeneous meshes never compare their topology
+		if (mode == TOPOLOGY_DETECT)
+		{
+			state.indices = mesh.getIndices();
+			state.face_counts = polymesh.face_counts;
+			state.uvs = mesh.getTexCoords();
+		}
+	}
+	else
+	{
+		num_topology_skipped++;
+	}
+
+	if (normals)
+		state.normals = mesh.getNormals();
+}
+
+void Writer::setTopologyMode(TopologyMode mode)
+{
+	flush();
+	default_topology_mode = mode;
+}
+
+void Writer::setTopologyMode(const string& path, TopologyMode mode)
+{
+	flush();
+	topology_modes[path] = mode;
+
+	std::unordered_map<string, ofPtr<Node> >::iterator it = nodes.find(path);
+	if (it != nodes.end())
+	{
+		it->second->has_topology_mode = true;
+		it->second->topology_mode = mode;
+	}
+}
+
+#pragma mark - frames
+
+void Writer::beginFrame()
+{
+	if (in_frame)
+	{
+		ofLogWarning("ofxAlembic::Writer") << "beginFrame called twice, the frame is written first";
+		endFrame();
+	}
+
+	in_frame = true;
+}
+
+void Writer::endFrame()
+{
+	if (!in_frame) return;
+	in_frame = false;
+
+	if (frame.empty()) return;
+
+	if (!async)
+	{
+		writeFrame(frame);
+		frame.clear();
+		return;
+	}
+
+	bool first = false;
+	for (size_t i = 0; i < frame.size(); i++)
+	{
+		Node *node = frame[i]->node.get();
+		if (!node->submitted) first = true;
+		node->submitted = true;
+	}
+
+	ofPtr<FrameJob> job(new FrameJob());
+	job->jobs.swap(frame);
+
+	// a frame that introduces an object is never dropped
+	if (reserve(first))
+		push(job);
+	else
+		push(job->repeat());
+}
+
+void Writer::writeFrame(const vector<ofPtr<Job> >& jobs)
+{
+	// samples of one object convert in order since topology modes compare against
+	// the previous one, different objects convert in parallel
+	vector<vector<size_t> > groups;
+	std::unordered_map<const Node*, size_t> group_index;
+
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		std::pair<std::unordered_map<const Node*, size_t>::iterator, bool> r = group_index.insert(make_pair(jobs[i]->node.get(), groups.size()));
+		if (r.second) groups.push_back(vector<size_t>());
+
+		groups[r.first->second].push_back(i);
+	}
+
+	// not vector<bool>, groups write their flags from different threads
+	vector<char> prepared(jobs.size(), false);
+
+	auto prepare_group = [&](size_t g)
+	{
+		for (size_t i = 0; i < groups[g].size(); i++)
+			prepared[groups[g][i]] = prepare(*jobs[groups[g][i]]);
+	};
+
+	if (pool && groups.size() > 1)
+	{
+		pool->parallelFor(0, groups.size(), prepare_group);
+	}
+	else
+	{
+		for (size_t g = 0; g < groups.size(); g++)
+			prepare_group(g);
+	}
+
+	// the archive sees the same calls in the same order as serial adds
+	for (size_t i = 0; i < jobs.size(); i++)
+		commit(*jobs[i], prepared[i]);
+}
+
+void Writer::fail(const std::exception& e)
+{
+	ofLogError("ofxAlembic::Writer") << e.what();
+	num_failed++;
+}
+
+bool Writer::prepare(Job& job)
+{
+	try
+	{
+		job.prepare(*this);
+		return true;
+	}
+	catch (std::exception &e)
+	{
+		fail(e);
+		return false;
+	}
+}
+
+void Writer::commit(Job& job, bool prepared)
+{
+	// a half converted sample is never written
+	if (!prepared)
+	{
+		job.repeat()->commit(*this);
+		return;
+	}
+
+	try
+	{
+		job.commit(*this);
+	}
+	catch (std::exception &e)
+	{
+		fail(e);
+	}
+}
+
+void Writer::setParallel(bool enable, size_t num_threads)
+{
+	// the writer thread may be converting a frame on the current pool
+	flush();
+
+	if (enable)
+		pool = ofPtr<ThreadPool>(new ThreadPool(num_threads));
+	else
+		pool.reset();
+}
+
 // time
 
 void Writer::setTime(float time)
@@ -115,4 +450,135 @@ void Writer::flashFrame()
 void Writer::rewind()
 {
 	setTime(0);
-}
\ No newline at end of file
+}
+
+#pragma mark - async
+
+void Writer::setAsync(bool enable, size_t max_size, QueuePolicy policy)
+{
+	if (!enable) stopThread();
+
+	std::lock_guard<std::mutex> lock(queue_mutex);
+
+	async = enable;
+	max_queue_size = std::max<size_t>(max_size, 1);
+	queue_policy = policy;
+
+	max_queue_depth = queue.size();
+	num_dropped = 0;
+	num_stalls = 0;
+}
+
+bool Writer::reserve(bool first)
+{
+	std::unique_lock<std::mutex> lock(queue_mutex);
+
+	if (queue.size() < max_queue_size || queue_policy == QUEUE_GROW)
+		return true;
+
+	if (queue_policy == QUEUE_DROP && !first)
+	{
+		num_dropped++;
+		return false;
+	}
+
+	num_stalls++;
+	done_cond.wait(lock, [&] { return queue.size() < max_queue_size; });
+
+	return true;
+}
+
+void Writer::push(const ofPtr<Job>& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+
+		queue.push_back(job);
+		max_queue_depth = std::max(max_queue_depth, queue.size());
+
+		if (!running)
+		{
+			running = true;
+			thread = std::thread(&Writer::threadLoop, this);
+		}
+	}
+
+	queue_cond.notify_one();
+}
+
+void Writer::flush()
+{
+	std::unique_lock<std::mutex> lock(queue_mutex);
+	done_cond.wait(lock, [&] { return queue.empty() && !writing; });
+}
+
+void Writer::stopThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		running = false;
+	}
+	queue_cond.notify_all();
+
+	// the thread drains the queue before it exits
+	if (thread.joinable())
+		thread.join();
+}
+
+void Writer::threadLoop()
+{
+	std::unique_lock<std::mutex> lock(queue_mutex);
+
+	while (true)
+	{
+		queue_cond.wait(lock, [&] { return !running || !queue.empty(); });
+		if (queue.empty()) break;
+
+		ofPtr<Job> job = queue.front();
+		queue.pop_front();
+		writing = true;
+
+		lock.unlock();
+		done_cond.notify_all();
+
+		// one thread keeps archive writes in submission order. writing has to be
+		// cleared whatever happens or flush waits forever
+		try
+		{
+			job->write(*this);
+		}
+		catch (std::exception &e)
+		{
+			fail(e);
+		}
+		job.reset();
+
+		lock.lock();
+		writing = false;
+		done_cond.notify_all();
+	}
+}
+
+size_t Writer::getQueueDepth() const
+{
+	std::lock_guard<std::mutex> lock(queue_mutex);
+	return queue.size();
+}
+
+size_t Writer::getMaxQueueDepth() const
+{
+	std::lock_guard<std::mutex> lock(queue_mutex);
+	return max_queue_depth;
+}
+
+size_t Writer::getNumDropped() const
+{
+	std::lock_guard<std::mutex> lock(queue_mutex);
+	return num_dropped;
+}
+
+size_t Writer::getNumStalls() const
+{
+	std::lock_guard<std::mutex> lock(queue_mutex);
+	return num_stalls;
+}
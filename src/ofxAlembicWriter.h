@@ -3,29 +3,106 @@
 #include "ofMain.h"
 
 #include "ofxAlembicType.h"
+#include "ofxAlembicThreadPool.h"
 
 #include <Alembic/AbcGeom/All.h>
 #include <Alembic/AbcCoreFactory/All.h>
 #include <Alembic/AbcCoreHDF5/All.h>
 #include <Alembic/AbcCoreOgawa/All.h>
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <unordered_map>
+
 namespace ofxAlembic
 {
 class Writer;
+
+// archive object type written for each value type
+template <typename T>
+struct OutputTraits {};
+
+template <>
+struct OutputTraits<XForm> { typedef Alembic::AbcGeom::OXform object_type; static Type type() { return XFORM; } };
+
+template <>
+struct OutputTraits<Points> { typedef Alembic::AbcGeom::OPoints object_type; static Type type() { return POINTS; } };
+
+template <>
+struct OutputTraits<Curves> { typedef Alembic::AbcGeom::OCurves object_type; static Type type() { return CURVES; } };
+
+template <>
+struct OutputTraits<PolyMesh> { typedef Alembic::AbcGeom::OPolyMesh object_type; static Type type() { return POLYMESH; } };
+
+template <>
+struct OutputTraits<Camera> { typedef Alembic::AbcGeom::OCamera object_type; static Type type() { return CAMERA; } };
 }
 
 class ofxAlembic::Writer
 {
+protected:
+
+	struct Node;
+
 public:
 
+	enum QueuePolicy
+	{
+		QUEUE_BLOCK, // add* waits until the writer thread made room
+		QUEUE_DROP, // add* repeats the object's previous sample instead of copying
+		QUEUE_GROW // the queue grows past its size, nothing waits
+	};
+
+	enum TopologyMode
+	{
+		TOPOLOGY_VARYING, // every sample is written in full
+		TOPOLOGY_DETECT, // indices, counts and uvs are compared against the last written sample
+		TOPOLOGY_HOMOGENEOUS // the caller asserts they never change after the first sample
+	};
+
+	// typed reference to an object of the open archive, valid until close
+	template <typename T>
+	class Handle
+	{
+		friend class Writer;
+
+	public:
+
+		typedef T value_type;
+
+		inline bool isValid() const { return node != NULL; }
+
+	protected:
+
+		ofPtr<Node> node;
+	};
+
+	Writer();
 	~Writer() { close(); }
 
 	bool open(const string& path, float fps = 30, Alembic::AbcCoreFactory::IFactory::CoreType type = Alembic::AbcCoreFactory::IFactory::kOgawa);
 	void close();
 
+	// declares an object once so per frame adds skip the path lookup, e.g. create<PolyMesh>("/a/mesh").
+	// missing parents are created as xforms, they get an identity sample if nothing else is written
+	// to them. invalid when the path is malformed or already holds another type
+	template <typename T>
+	Handle<T> create(const string& path);
+
+	template <typename T>
+	void add(const Handle<T>& handle, const typename Handle<T>::value_type& value);
+	template <typename T>
+	void add(const Handle<T>& handle, typename Handle<T>::value_type&& value);
+
 	void addPoints(const string& path, const Points& points);
+	void addPoints(const string& path, Points&& points);
 	void addPolyMesh(const string& path, const PolyMesh& polymesh);
+	void addPolyMesh(const string& path, PolyMesh&& polymesh);
 	void addCurves(const string& path, const Curves& curves);
+	void addCurves(const string& path, Curves&& curves);
 	void addXform(const string& path, const XForm& xform);
 	void addCamera(const string& path, const Camera& camera);
 	void addCamera(const string& path, const ofCamera& camera);
@@ -37,67 +114,325 @@ public:
 
 	void flashFrame();
 
+	// in async mode add* only copies or moves its input into a queue of max_size
+	// samples, a background thread converts and writes them in submission order
+	void setAsync(bool enable, size_t max_size = 64, QueuePolicy policy = QUEUE_BLOCK);
+	bool isAsync() const { return async; }
+
+	// waits until every queued sample is in the archive
+	void flush();
+
+	size_t getQueueDepth() const;
+	size_t getMaxQueueDepth() const; // since the last setAsync
+	size_t getNumDropped() const;
+	size_t getNumStalls() const; // add* calls that waited for room
+
+	// polymeshes with unchanged topology write only positions after their first sample,
+	// plus normals when they changed. flushes the queue in async mode
+	void setTopologyMode(TopologyMode mode); // objects without their own mode
+	void setTopologyMode(const string& path, TopologyMode mode);
+
+	template <typename T>
+	void setTopologyMode(const Handle<T>& handle, TopologyMode mode);
+
+	// samples written with positions only
+	size_t getNumTopologySkipped() const { return num_topology_skipped; }
+
+	// writes that threw since open, each one is logged. a sample that fails to convert
+	// repeats the previous one of its object
+	size_t getNumFailed() const { return num_failed; }
+
+	// adds between beginFrame and endFrame are collected, converted on the pool of setParallel
+	// at endFrame and written in submission order, so the archive is byte identical to serial
+	// adds. in async mode a frame is one queue entry
+	void beginFrame();
+	void endFrame();
+
+	// num_threads == 0 uses all cores
+	void setParallel(bool enable, size_t num_threads = 0);
+	inline bool isParallel() const { return pool != NULL; }
+
 protected:
 
-	map<string, Alembic::AbcGeom::OObject*> object_map;
+	// the last written state of a polymesh
+	struct MeshState
+	{
+		bool written;
+		size_t num_points;
+		vector<ofIndexType> indices;
+		vector<int32_t> face_counts;
+		vector<glm::vec2> uvs;
+		vector<glm::vec3> normals;
+
+		MeshState() : written(false), num_points(0) {}
+	};
+
+	struct Node
+	{
+		string name;
+		ofPtr<Node> parent; // NULL below the top
+		Type type;
+		size_t generation; // of the archive it was declared in
+
+		bool submitted; // caller's thread, the first sample is never dropped
+
+		// writer thread only
+		Alembic::AbcGeom::OObject *object;
+		bool has_topology_mode;
+		TopologyMode topology_mode;
+		MeshState mesh;
+
+		Node() : type(UNKHOWN), generation(0), submitted(false), object(NULL), has_topology_mode(false), topology_mode(TOPOLOGY_VARYING) {}
+	};
+
+	struct Job
+	{
+		ofPtr<Node> node;
+		float time;
+
+		virtual ~Job() {}
+
+		// conversion only, any thread
+		virtual void prepare(Writer& writer) {}
+		// archive writes, one thread in submission order
+		virtual void commit(Writer& writer) = 0;
+		// what is written instead when the sample is dropped
+		virtual ofPtr<Job> repeat() const = 0;
+
+		void write(Writer& writer) { writer.commit(*this, writer.prepare(*this)); }
+	};
+
+	// a dropped sample, the object keeps its previous one so later samples stay on their frame
+	template <typename O>
+	struct RepeatJob : public Job
+	{
+		void commit(Writer& writer) { writer.repeat<O>(*this->node, this->time); }
+		ofPtr<Job> repeat() const { return ofPtr<Job>(new RepeatJob<O>(*this)); }
+	};
+
+	template <typename O, typename T>
+	struct SampleJob : public Job
+	{
+		T value;
+		typename T::Output out;
+
+		SampleJob(const T& value) : value(value) {}
+		SampleJob(T&& value) : value(std::move(value)) {}
+
+		void prepare(Writer& writer) { writer.convert(*this->node, value, out); }
+		void commit(Writer& writer) { out.write(writer.getObject<O>(*this->node, this->time).getSchema()); }
+
+		ofPtr<Job> repeat() const
+		{
+			RepeatJob<O> *job = new RepeatJob<O>();
+			job->node = this->node;
+			job->time = this->time;
+			return ofPtr<Job>(job);
+		}
+	};
+
+	// the samples added between beginFrame and endFrame
+	struct FrameJob : public Job
+	{
+		vector<ofPtr<Job> > jobs;
+
+		void commit(Writer& writer) { writer.writeFrame(jobs); }
+
+		ofPtr<Job> repeat() const
+		{
+			FrameJob *job = new FrameJob();
+			for (size_t i = 0; i < jobs.size(); i++)
+				job->jobs.push_back(jobs[i]->repeat());
+			return ofPtr<Job>(job);
+		}
+	};
+
 	Alembic::AbcGeom::OArchive archive;
 
+	// caller's thread, every declared object by full path
+	std::unordered_map<string, ofPtr<Node> > nodes;
+	vector<ofPtr<Node> > declared; // in declaration order
+	map<string, TopologyMode> topology_modes;
+	size_t generation;
+
+	// writer thread, one time sampling per start time, all at the same fps
+	map<float, Alembic::Util::uint32_t> time_samplings;
+
 	float inv_fps;
 	float current_time;
 
+	bool async;
+	size_t max_queue_size;
+	QueuePolicy queue_policy;
+
+	mutable std::mutex queue_mutex;
+	std::condition_variable queue_cond, done_cond;
+	std::thread thread;
+	std::deque<ofPtr<Job> > queue;
+
+	bool running;
+	bool writing;
+	size_t max_queue_depth;
+	size_t num_dropped;
+	size_t num_stalls;
+
+	// read by the writer thread, changed only after a flush
+	TopologyMode default_topology_mode;
+	std::atomic<size_t> num_topology_skipped;
+	std::atomic<size_t> num_failed;
+
+	// caller's thread
+	bool in_frame;
+	vector<ofPtr<Job> > frame;
+
+	// replaced only after a flush
+	ofPtr<ThreadPool> pool;
+
+	template <typename O, typename T>
+	void write(Node& node, const T& value, float time)
+	{
+		typename T::Output out;
+		bool converted = false;
+
+		try
+		{
+			convert(node, value, out);
+			converted = true;
+
+			out.write(getObject<O>(node, time).getSchema());
+		}
+		catch (std::exception &e)
+		{
+			fail(e);
+			if (!converted) repeat<O>(node, time);
+		}
+	}
+
+	// the object keeps its previous sample so later samples stay on their frame
+	template <typename O>
+	void repeat(Node& node, float time)
+	{
+		try
+		{
+			getObject<O>(node, time).getSchema().setFromPrevious();
+		}
+		catch (std::exception &e)
+		{
+			fail(e);
+		}
+	}
+
+	// exceptions from Alembic are logged and counted, the writer keeps going
+	void fail(const std::exception& e);
+	bool prepare(Job& job);
+	void commit(Job& job, bool prepared);
+
+	template <typename T>
+	void convert(Node& node, const T& value, typename T::Output& out)
+	{
+		value.convert(out);
+	}
+
+	void convert(Node& node, const PolyMesh& polymesh, PolyMesh::Output& out);
+	void writeFrame(const vector<ofPtr<Job> >& jobs);
+
 	template <typename T>
-	T& getObject(const string& path)
+	void submit(const string& path, T&& value)
 	{
-		using namespace Alembic::AbcGeom;
-		
-		// validation
-		if (path.empty()
-			|| path[0] != '/'
-			|| path[path.size() - 1] == '/')
+		typedef typename std::decay<T>::type V;
+		submit(create<V>(path), std::forward<T>(value));
+	}
+
+	template <typename V, typename T>
+	void submit(const Handle<V>& handle, T&& value)
+	{
+		typedef typename OutputTraits<V>::object_type O;
+
+		Node *node = handle.node.get();
+		if (node == NULL || node->generation != generation || !archive.valid())
 		{
-			ofLogError("ofxAlembic::Writer") << "invalid path: '" << path << "'";
-			throw;
+			ofLogError("ofxAlembic::Writer") << "invalid handle";
+			return;
 		}
-		
-		map<string, OObject*>::iterator it = object_map.find(path);
-		
-		// return if already created
-		if (it != object_map.end())
-			return *(T*)(it->second);
-
-		vector<string> e = ofSplitString(path, "/", true, true);
-		string new_object_name = e.back();
-		
-		TimeSampling Ts(inv_fps, current_time);
-		Alembic::Util::uint32_t tsidx = archive.addTimeSampling(Ts);
-		
-		if (e.size() > 1)
+
+		if (in_frame)
 		{
-			// root object
-			string parent_path = "/" + ofJoinString(vector<string>(e.begin(), e.end() - 1), "/");
-			
-			map<string, OObject*>::iterator parent_it = object_map.find(parent_path);
-			if (parent_it == object_map.end())
-			{
-				ofLogError("ofxAlembic::Writer") << "parent object not found: '" << path << "'";
-				throw;
-			}
-			
-			OObject* parent_object = parent_it->second;
-			
-			T *t = new T(*parent_object, new_object_name);
-			t->getSchema().setTimeSampling(tsidx);
-			object_map[path] = t;
-			
-			return *t;
+			ofPtr<Job> job(new SampleJob<O, V>(std::forward<T>(value)));
+			job->node = handle.node;
+			job->time = current_time;
+
+			frame.push_back(job);
+			return;
 		}
-		else
+
+		if (!async)
 		{
-			T *t = new T(archive.getTop(), new_object_name);
-			t->getSchema().setTimeSampling(tsidx);
-			object_map[path] = t;
-			
-			return *t;
+			write<O>(*node, value, current_time);
+			return;
 		}
+
+		// objects are created with the time of their first sample, repeating it isn't possible
+		const bool first = !node->submitted;
+		node->submitted = true;
+
+		// the copy happens outside the lock, the writer thread keeps going meanwhile
+		ofPtr<Job> job;
+		if (reserve(first))
+			job = ofPtr<Job>(new SampleJob<O, V>(std::forward<T>(value)));
+		else
+			job = ofPtr<Job>(new RepeatJob<O>());
+
+		job->node = handle.node;
+		job->time = current_time;
+
+		push(job);
 	}
-};
\ No newline at end of file
+
+	ofPtr<Node> declare(const string& path, Type type);
+
+	// builds the object and its parents on first use, with time sampling starting at time
+	Alembic::AbcGeom::OObject& construct(Node& node, float time);
+	Alembic::Util::uint32_t getTimeSampling(float time);
+
+	template <typename O>
+	O& getObject(Node& node, float time)
+	{
+		// the node type was checked when it was declared
+		return static_cast<O&>(construct(node, time));
+	}
+
+	bool reserve(bool first);
+	void push(const ofPtr<Job>& job);
+	void stopThread();
+	void threadLoop();
+};
+
+template <typename T>
+inline ofxAlembic::Writer::Handle<T> ofxAlembic::Writer::create(const string& path)
+{
+	Handle<T> handle;
+	handle.node = declare(path, OutputTraits<T>::type());
+	return handle;
+}
+
+template <typename T>
+inline void ofxAlembic::Writer::add(const Handle<T>& handle, const typename Handle<T>::value_type& value)
+{
+	submit(handle, value);
+}
+
+template <typename T>
+inline void ofxAlembic::Writer::add(const Handle<T>& handle, typename Handle<T>::value_type&& value)
+{
+	submit(handle, std::move(value));
+}
+
+template <typename T>
+inline void ofxAlembic::Writer::setTopologyMode(const Handle<T>& handle, TopologyMode mode)
+{
+	if (!handle.isValid()) return;
+
+	flush();
+	handle.node->has_topology_mode = true;
+	handle.node->topology_mode = mode;
+}